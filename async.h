@@ -0,0 +1,53 @@
+#pragma once
+
+#include "execution_control.h"
+#include "linear_operator.h"
+#include "matrix.h"
+#include "myconcepts.h"
+#include "poly.h"
+#include "thread_pool.h"
+
+#include <future>
+#include <type_traits>
+#include <utility>
+
+// Runs task on the global ThreadPool with control current, so the loops it
+// goes through stop early by throwing OperationCancelledException or
+// DeadlineExceededException, which then comes out of the future's get().
+// A task whose control is already stopped or past its deadline doesn't start
+template <typename F>
+std::future<std::invoke_result_t<F>> Async(F task, ExecutionControl control = {}) {
+    return ThreadPool::Global().Submit([task = std::move(task), control = std::move(control)]() mutable {
+        ExecutionScope scope(&control);
+        control.Check();
+        return task();
+    });
+}
+
+template <RingWithOne T>
+std::future<T> DetAsync(Matrix<T> matrix, ExecutionControl control = {}) {
+    return Async([matrix = std::move(matrix)]() mutable {
+        return Det(std::move(matrix));
+    }, std::move(control));
+}
+
+template <RingWithOne T>
+std::future<Poly<T>> CharPolyAsync(Matrix<T> matrix, ExecutionControl control = {}) {
+    return Async([matrix = std::move(matrix)] {
+        return matrix.CharPoly();
+    }, std::move(control));
+}
+
+template <Field T>
+std::future<Matrix<T>> JNFAsync(LinearOperator<T> op, ExecutionControl control = {}) {
+    return Async([op = std::move(op)] {
+        return op.GetJNF();
+    }, std::move(control));
+}
+
+template <Field T>
+std::future<Matrix<T>> JordanBasisAsync(LinearOperator<T> op, ExecutionControl control = {}) {
+    return Async([op = std::move(op)] {
+        return op.GetJordanBasis();
+    }, std::move(control));
+}
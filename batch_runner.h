@@ -0,0 +1,484 @@
+#pragma once
+
+#include "exceptions.h"
+#include "format.h"
+#include "linear_operator.h"
+#include "matrix.h"
+#include "matrix_io.h"
+#include "myconcepts.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+enum class JobStatus {
+    Done,
+    Failed,       // The handler threw; output is what()
+    OutOfMemory,  // The handler ran out of the memory limit
+    TimedOut,
+    Crashed,      // The worker died; output says how
+};
+
+struct JobResult {
+    size_t job;
+    JobStatus status;
+    std::string output;
+    size_t attempts;
+};
+
+struct BatchLimits {
+    size_t memory_bytes = 0;                      // Address space of a worker, 0 for no limit
+    std::chrono::milliseconds time{0};            // Per attempt, 0 for no limit
+    size_t attempts = 1;                          // Tries of a job that timed out or crashed
+};
+
+// Runs string-to-string jobs in forked worker processes, one job per worker
+// at a time, so that a job that blows up takes down only its worker. Workers
+// are restarted after a crash or a timeout, and those jobs are tried again up
+// to BatchLimits::attempts times in total; a handler that throws or runs out
+// of memory fails its job for good, since trying again would do the same.
+// Jobs and results go over a Unix socket per worker as length-prefixed
+// frames. Workers' stdout goes to /dev/null, so that chatty handlers don't
+// mix with the caller's output.
+// The constructor forks exactly once, a zygote process that forks all
+// workers, replacements included, and reaps them. A fork copies only the
+// calling thread, so forking in the middle of a run from a process whose
+// ThreadPool holds a lock would leave the child stuck on it; the zygote never
+// starts threads, so its forks are always safe. Only that first fork isn't,
+// so construct runners before anything starts the global ThreadPool
+class BatchRunner {
+public:
+    using Handler = std::function<std::string(const std::string&)>;
+
+    BatchRunner(Handler handler, size_t workers = std::max<size_t>(1, std::thread::hardware_concurrency()),
+                BatchLimits limits = {})
+        : handler_(std::move(handler)), limits_(limits), workers_(std::max<size_t>(1, workers)) {
+        StartZygote();
+        for (auto& worker : workers_) {
+            Spawn(worker);
+        }
+    }
+    BatchRunner(const BatchRunner& other) = delete;
+    BatchRunner& operator=(const BatchRunner& other) = delete;
+
+    ~BatchRunner() {
+        for (auto& worker : workers_) {
+            Stop(worker);
+        }
+        close(zygote_fd_);
+        while (waitpid(zygote_pid_, nullptr, 0) < 0 && errno == EINTR) {
+        }
+    }
+
+    // Calls on_result for every job as soon as it finishes, in completion order
+    void Run(const std::vector<std::string>& jobs, const std::function<void(const JobResult&)>& on_result) {
+        std::deque<size_t> pending;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            pending.push_back(i);
+        }
+        std::vector<size_t> attempts(jobs.size());
+        size_t finished = 0;
+        auto fail = [&](size_t job, JobStatus status, std::string output) {
+            if (++attempts[job] < limits_.attempts) {
+                pending.push_front(job);
+                return;
+            }
+            ++finished;
+            on_result({job, status, std::move(output), attempts[job]});
+        };
+
+        while (finished < jobs.size()) {
+            for (auto& worker : workers_) {
+                if (worker.job || pending.empty()) {
+                    continue;
+                }
+                size_t job = pending.front();
+                pending.pop_front();
+                if (!WriteFrame(worker.fd, jobs[job])) {
+                    // Died while idle: nothing of the job ran
+                    Restart(worker);
+                    pending.push_front(job);
+                    continue;
+                }
+                worker.job = job;
+                worker.started = Clock::now();
+            }
+
+            std::vector<pollfd> fds;
+            std::vector<Worker*> polled;
+            auto timeout = std::chrono::milliseconds(-1);
+            for (auto& worker : workers_) {
+                if (!worker.job) {
+                    continue;
+                }
+                fds.push_back({worker.fd, POLLIN, 0});
+                polled.push_back(&worker);
+                if (limits_.time.count() != 0) {
+                    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        worker.started + limits_.time - Clock::now());
+                    left = std::max(left, std::chrono::milliseconds(0));
+                    timeout = timeout.count() < 0 ? left : std::min(timeout, left);
+                }
+            }
+            if (fds.empty()) {
+                continue;
+            }
+            if (poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) < 0 && errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "poll");
+            }
+
+            for (size_t i = 0; i < fds.size(); ++i) {
+                Worker& worker = *polled[i];
+                size_t job = *worker.job;
+                if (fds[i].revents != 0) {
+                    std::string frame;
+                    worker.job.reset();
+                    if (!ReadFrame(worker.fd, frame) || frame.empty()) {
+                        std::string reason = Restart(worker);
+                        fail(job, JobStatus::Crashed, reason);
+                        continue;
+                    }
+                    auto status = static_cast<JobStatus>(frame[0]);
+                    frame.erase(0, 1);
+                    ++attempts[job];
+                    ++finished;
+                    on_result({job, status, std::move(frame), attempts[job]});
+                } else if (limits_.time.count() != 0 && Clock::now() >= worker.started + limits_.time) {
+                    worker.job.reset();
+                    Restart(worker);
+                    fail(job, JobStatus::TimedOut, "");
+                }
+            }
+        }
+    }
+
+    // All results, in the order of jobs
+    std::vector<JobResult> Run(const std::vector<std::string>& jobs) {
+        std::vector<JobResult> ans(jobs.size());
+        Run(jobs, [&ans](const JobResult& result) {
+            ans[result.job] = result;
+        });
+        return ans;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Worker {
+        pid_t pid = -1;
+        int fd = -1;
+        std::optional<size_t> job;
+        Clock::time_point started;
+    };
+
+    enum class ZygoteRequest : char {
+        Spawn,  // Answered with SpawnReply and, on success, the worker's socket
+        Reap,   // Followed by the pid, answered with the wait status
+    };
+
+    struct SpawnReply {
+        pid_t pid;  // -1 on failure
+        int error;
+    };
+
+    void StartZygote() {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0) {
+            throw std::system_error(errno, std::generic_category(), "socketpair");
+        }
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid < 0) {
+            int error = errno;
+            close(sockets[0]);
+            close(sockets[1]);
+            throw std::system_error(error, std::generic_category(), "fork");
+        }
+        if (pid == 0) {
+            close(sockets[0]);
+            ZygoteMain(sockets[1]);
+        }
+        close(sockets[1]);
+        zygote_pid_ = pid;
+        zygote_fd_ = sockets[0];
+    }
+
+    // Single-threaded for its whole life, it is the parent of every worker
+    [[noreturn]] void ZygoteMain(int fd) {
+        ZygoteRequest request;
+        while (ReadBytes(fd, &request, sizeof(request))) {
+            if (request == ZygoteRequest::Reap) {
+                pid_t pid;
+                if (!ReadBytes(fd, &pid, sizeof(pid))) {
+                    break;
+                }
+                kill(pid, SIGKILL);
+                int status = 0;
+                while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+                }
+                if (!WriteBytes(fd, &status, sizeof(status))) {
+                    break;
+                }
+                continue;
+            }
+            int sockets[2];
+            SpawnReply reply{-1, 0};
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0) {
+                reply.error = errno;
+                WriteBytes(fd, &reply, sizeof(reply));
+                continue;
+            }
+            reply.pid = fork();
+            if (reply.pid == 0) {
+                close(fd);
+                close(sockets[0]);
+                WorkerMain(sockets[1]);
+            }
+            reply.error = errno;
+            close(sockets[1]);
+            bool sent = SendWithFd(fd, &reply, sizeof(reply), reply.pid < 0 ? -1 : sockets[0]);
+            close(sockets[0]);
+            if (!sent) {
+                break;
+            }
+        }
+        _exit(0);
+    }
+
+    void Spawn(Worker& worker) {
+        ZygoteRequest request = ZygoteRequest::Spawn;
+        SpawnReply reply;
+        int fd = -1;
+        if (!WriteBytes(zygote_fd_, &request, sizeof(request)) || !ReceiveWithFd(zygote_fd_, &reply, sizeof(reply), fd)) {
+            throw std::system_error(EPIPE, std::generic_category(), "zygote");
+        }
+        if (reply.pid < 0) {
+            throw std::system_error(reply.error, std::generic_category(), "fork");
+        }
+        worker.pid = reply.pid;
+        worker.fd = fd;
+    }
+
+    // Kills the worker and has the zygote reap it; returns how it ended
+    std::string Stop(Worker& worker) {
+        if (worker.pid < 0) {
+            return "";
+        }
+        close(worker.fd);
+        ZygoteRequest request = ZygoteRequest::Reap;
+        int status = 0;
+        bool reaped = WriteBytes(zygote_fd_, &request, sizeof(request)) &&
+                      WriteBytes(zygote_fd_, &worker.pid, sizeof(worker.pid)) &&
+                      ReadBytes(zygote_fd_, &status, sizeof(status));
+        worker.pid = -1;
+        worker.fd = -1;
+        if (!reaped) {
+            return "lost with the zygote";
+        }
+        if (WIFSIGNALED(status)) {
+            return "killed by signal " + std::to_string(WTERMSIG(status));
+        }
+        return "exited with code " + std::to_string(WEXITSTATUS(status));
+    }
+
+    std::string Restart(Worker& worker) {
+        std::string reason = Stop(worker);
+        Spawn(worker);
+        return reason;
+    }
+
+    [[noreturn]] void WorkerMain(int fd) {
+        if (limits_.memory_bytes != 0) {
+            rlimit limit{limits_.memory_bytes, limits_.memory_bytes};
+            setrlimit(RLIMIT_AS, &limit);
+        }
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            close(null);
+        }
+        std::string job;
+        while (ReadFrame(fd, job)) {
+            std::string frame(1, static_cast<char>(JobStatus::Done));
+            try {
+                frame += handler_(job);
+            } catch (const std::bad_alloc&) {
+                frame.assign(1, static_cast<char>(JobStatus::OutOfMemory));
+            } catch (const std::exception& e) {
+                frame.assign(1, static_cast<char>(JobStatus::Failed));
+                frame += e.what();
+            } catch (...) {
+                frame.assign(1, static_cast<char>(JobStatus::Failed));
+            }
+            std::cout.flush();
+            if (!WriteFrame(fd, frame)) {
+                break;
+            }
+        }
+        // Skips the destructors of statics, the ThreadPool among them, which
+        // belong to the parent
+        _exit(0);
+    }
+
+    static bool WriteFrame(int fd, std::string_view data) {
+        uint64_t size = data.size();
+        return WriteBytes(fd, &size, sizeof(size)) && WriteBytes(fd, data.data(), data.size());
+    }
+
+    static bool ReadFrame(int fd, std::string& data) {
+        uint64_t size;
+        if (!ReadBytes(fd, &size, sizeof(size))) {
+            return false;
+        }
+        data.resize(size);
+        return ReadBytes(fd, data.data(), size);
+    }
+
+    // MSG_NOSIGNAL: a dead peer is an error, not a SIGPIPE
+    static bool WriteBytes(int fd, const void* data, size_t size) {
+        const char* position = static_cast<const char*>(data);
+        while (size != 0) {
+            ssize_t done = send(fd, position, size, MSG_NOSIGNAL);
+            if (done < 0 && errno == EINTR) {
+                continue;
+            }
+            if (done <= 0) {
+                return false;
+            }
+            position += done;
+            size -= static_cast<size_t>(done);
+        }
+        return true;
+    }
+
+    // size bytes of data with fd attached, if fd >= 0
+    static bool SendWithFd(int socket, const void* data, size_t size, int fd) {
+        iovec part{const_cast<void*>(data), size};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr message{};
+        message.msg_iov = &part;
+        message.msg_iovlen = 1;
+        if (fd >= 0) {
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            cmsghdr* header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+        }
+        ssize_t done;
+        while ((done = sendmsg(socket, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR) {
+        }
+        if (done <= 0) {
+            return false;
+        }
+        return WriteBytes(socket, static_cast<const char*>(data) + done, size - static_cast<size_t>(done));
+    }
+
+    // Counterpart of SendWithFd; fd is -1 if none came
+    static bool ReceiveWithFd(int socket, void* data, size_t size, int& fd) {
+        iovec part{data, size};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr message{};
+        message.msg_iov = &part;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t done;
+        while ((done = recvmsg(socket, &message, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+        }
+        if (done <= 0) {
+            return false;
+        }
+        fd = -1;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+            }
+        }
+        return ReadBytes(socket, static_cast<char*>(data) + done, size - static_cast<size_t>(done));
+    }
+
+    static bool ReadBytes(int fd, void* data, size_t size) {
+        char* position = static_cast<char*>(data);
+        while (size != 0) {
+            ssize_t done = read(fd, position, size);
+            if (done < 0 && errno == EINTR) {
+                continue;
+            }
+            if (done <= 0) {
+                return false;
+            }
+            position += done;
+            size -= static_cast<size_t>(done);
+        }
+        return true;
+    }
+
+    Handler handler_;
+    BatchLimits limits_;
+    std::vector<Worker> workers_;
+    pid_t zygote_pid_ = -1;
+    int zygote_fd_ = -1;
+};
+
+// Jobs for MatrixJobHandler: the operation on the first line, the matrix in
+// the text format of matrix_io.h after it. Operations are Det and CharPoly,
+// and for fields also rk and JNF
+template <TextParsable T>
+std::string MatrixJob(std::string_view operation, const Matrix<T>& matrix) {
+    std::string ans(operation);
+    ans += '\n';
+    ans += PrintMatrix(matrix);
+    return ans;
+}
+
+template <TextParsable T>
+BatchRunner::Handler MatrixJobHandler() {
+    return [](const std::string& job) {
+        size_t line_end = std::min(job.find('\n'), job.size());
+        std::string_view operation(job.data(), line_end);
+        Matrix<T> matrix = ParseMatrix<T>(std::string_view(job).substr(std::min(line_end + 1, job.size())));
+        std::string ans;
+        if (operation == "Det") {
+            ScalarFormat<T>::Print(ans, Det(matrix));
+        } else if (operation == "CharPoly") {
+            FormatTo(ans, matrix.CharPoly());
+        } else if constexpr (Field<T>) {
+            if (operation == "rk") {
+                FormatTo(ans, static_cast<long long>(matrix.rk()));
+            } else if (operation == "JNF") {
+                Matrix<T> jnf = LinearOperator<T>(matrix).GetJNF();
+                ans = PrintMatrix(jnf);
+            } else {
+                throw FormatException();
+            }
+        } else {
+            throw FormatException();
+        }
+        return ans;
+    };
+}
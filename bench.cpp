@@ -0,0 +1,309 @@
+#include "float.h"
+#include "fraction.h"
+#include "integer.h"
+#include "integer_mod.h"
+#include "linear_operator.h"
+#include "matrix.h"
+#include "mymath.h"
+#include "permutation.h"
+#include "poly.h"
+#include "poly_gcd.h"
+#include "vector.h"
+#include "vector_space.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Usage: bench [--sizes 4,8,16] [--filter Det] [--min-time 0.2]
+// Prints one JSON object with a record per (benchmark, type, size).
+// Exact types overflow long long quickly, so Integer and Fraction<Integer>
+// only run sizes up to EXACT_LIMIT, and the cubic-in-polynomials ones
+// (CharPoly, GetJNF) only up to POLY_LIMIT for every type
+
+using namespace std;
+
+using Frac = Fraction<Integer>;
+
+const size_t EXACT_LIMIT = 8;
+const size_t POLY_LIMIT = 6;
+
+struct Options {
+    vector<size_t> sizes = {4, 8, 16, 32};
+    string filter;
+    double min_time = 0.2;
+};
+
+struct Record {
+    string name;
+    string type;
+    size_t size;
+    size_t iterations;
+    double ns_per_op;
+};
+
+Options options;
+vector<Record> records;
+
+// Poly::try_solve logs to cout, which would break the JSON
+struct NullBuffer : streambuf {
+    int overflow(int c) override {
+        return c;
+    }
+};
+
+template <typename T>
+string TypeName() {
+    if constexpr (is_same_v<T, Integer>) {
+        return "Integer";
+    } else if constexpr (is_same_v<T, IntegerMod>) {
+        return "IntegerMod";
+    } else if constexpr (is_same_v<T, Frac>) {
+        return "Fraction<Integer>";
+    } else {
+        return "Float";
+    }
+}
+
+template <typename T>
+constexpr bool IS_EXACT = is_same_v<T, Integer> || is_same_v<T, Frac>;
+
+template <typename T>
+bool Enabled(const string& name, size_t size, size_t limit = static_cast<size_t>(-1)) {
+    if (IS_EXACT<T>) {
+        limit = min(limit, EXACT_LIMIT);
+    }
+    return size <= limit && name.find(options.filter) != string::npos;
+}
+
+// Keeps the result alive so the optimizer can't drop the call
+template <typename R>
+void Sink(const R& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Doubles the iteration count until one batch takes at least min_time
+template <typename T, typename F>
+void Run(const string& name, size_t size, F body) {
+    using Clock = chrono::steady_clock;
+    Sink(body());
+    for (size_t iterations = 1;; iterations *= 2) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            Sink(body());
+        }
+        double elapsed = chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed >= options.min_time) {
+            records.push_back({name, TypeName<T>(), size, iterations, elapsed * 1e9 / static_cast<double>(iterations)});
+            return;
+        }
+    }
+}
+
+// Entries from {-1, 0, 1} keep the exact types away from overflow
+template <typename T>
+T RandomScalar(mt19937& rng) {
+    return FromInteger<T>(static_cast<long long>(rng() % 3) - 1);
+}
+
+template <typename T>
+Matrix<T> RandomMatrix(size_t n, mt19937& rng) {
+    Matrix<T> ans(n, n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            ans[i][j] = RandomScalar<T>(rng);
+        }
+    }
+    return ans;
+}
+
+// Upper triangular with eigenvalues 1 and 2, so that GetJNF finds them all
+template <typename T>
+Matrix<T> TriangularMatrix(size_t n, mt19937& rng) {
+    Matrix<T> ans(n, n);
+    for (size_t i = 0; i < n; ++i) {
+        ans[i][i] = FromInteger<T>(1 + static_cast<long long>(i % 2));
+        for (size_t j = i + 1; j < n; ++j) {
+            ans[i][j] = RandomScalar<T>(rng);
+        }
+    }
+    return ans;
+}
+
+template <typename T>
+Poly<T> RandomPoly(size_t degree, mt19937& rng) {
+    vector<T> coefficients(degree + 1);
+    for (auto& coefficient : coefficients) {
+        coefficient = RandomScalar<T>(rng);
+    }
+    coefficients[degree] = T::ONE();
+    return Poly<T>(coefficients);
+}
+
+template <typename T>
+void BenchMatrix(size_t n) {
+    mt19937 rng(n);
+    Matrix<T> a = RandomMatrix<T>(n, rng);
+    Matrix<T> b = RandomMatrix<T>(n, rng);
+    if (Enabled<T>("Matrix/Multiply", n)) {
+        Run<T>("Matrix/Multiply", n, [&] { return a * b; });
+    }
+    if (Enabled<T>("Matrix/Det", n)) {
+        Run<T>("Matrix/Det", n, [&] { return Det(a); });
+    }
+    if (Enabled<T>("Matrix/CharPoly", n, POLY_LIMIT)) {
+        Run<T>("Matrix/CharPoly", n, [&] { return a.CharPoly(); });
+    }
+    if constexpr (Field<T>) {
+        Matrix<T> invertible = TriangularMatrix<T>(n, rng) * TriangularMatrix<T>(n, rng).Transpose();
+        if (Enabled<T>("Matrix/Inverse", n)) {
+            Run<T>("Matrix/Inverse", n, [&] { return invertible.Inverse(); });
+        }
+        if (Enabled<T>("Matrix/Gauss", n)) {
+            Run<T>("Matrix/Gauss", n, [&] {
+                Matrix<T> copy = a;
+                copy.Gauss();
+                return copy;
+            });
+        }
+        if (Enabled<T>("Matrix/rk", n)) {
+            Run<T>("Matrix/rk", n, [&] { return a.rk(); });
+        }
+        Matrix<T> triangular = TriangularMatrix<T>(n, rng);
+        if (Enabled<T>("LinearOperator/GetJNF", n, POLY_LIMIT)) {
+            Run<T>("LinearOperator/GetJNF", n, [&] { return LinearOperator<T>(triangular).GetJNF(); });
+        }
+    }
+}
+
+template <typename T>
+void BenchPoly(size_t degree) {
+    mt19937 rng(degree);
+    Poly<T> a = RandomPoly<T>(degree, rng);
+    Poly<T> b = RandomPoly<T>(degree, rng);
+    if (Enabled<T>("Poly/Multiply", degree)) {
+        Run<T>("Poly/Multiply", degree, [&] { return a * b; });
+    }
+    if constexpr (Field<T>) {
+        Poly<T> product = a * b + RandomPoly<T>(degree / 2, rng);
+        if (Enabled<T>("Poly/Divide", degree)) {
+            Run<T>("Poly/Divide", degree, [&] { return product / a; });
+        }
+        if (Enabled<T>("Poly/Gcd", degree)) {
+            Run<T>("Poly/Gcd", degree, [&] { return gcd(product, a); });
+        }
+    }
+}
+
+template <typename T>
+void BenchVectorSpace(size_t n) {
+    if constexpr (Field<T>) {
+        mt19937 rng(n);
+        auto span = [&](size_t count) {
+            vector<Vector<T>> vectors;
+            for (size_t i = 0; i < count; ++i) {
+                Vector<T> v(n);
+                for (size_t j = 0; j < n; ++j) {
+                    v[j] = RandomScalar<T>(rng);
+                }
+                vectors.push_back(v);
+            }
+            return vectors;
+        };
+        vector<Vector<T>> u = span(n / 2 + 1);
+        vector<Vector<T>> w = span(n / 2 + 1);
+        VectorSpace<T> first(u);
+        VectorSpace<T> second(w);
+        if (Enabled<T>("VectorSpace/Span", n)) {
+            Run<T>("VectorSpace/Span", n, [&] { return VectorSpace<T>(u); });
+        }
+        if (Enabled<T>("VectorSpace/Sum", n)) {
+            Run<T>("VectorSpace/Sum", n, [&] { return first + second; });
+        }
+        if (Enabled<T>("VectorSpace/Intersection", n)) {
+            Run<T>("VectorSpace/Intersection", n, [&] { return first.inter(second); });
+        }
+    }
+}
+
+template <typename T>
+void BenchType() {
+    for (size_t n : options.sizes) {
+        BenchMatrix<T>(n);
+        BenchPoly<T>(n);
+        BenchVectorSpace<T>(n);
+    }
+}
+
+void BenchPermutations() {
+    // n! grows too fast for the usual sizes, so these are fixed
+    for (size_t n : {6, 8, 10}) {
+        if (n <= 8 && string("Permutation/Enumerate").find(options.filter) != string::npos) {
+            Run<Integer>("Permutation/Enumerate", n, [n] {
+                size_t count = 0;
+                for (const auto& p : AllPermutations(n)) {
+                    count += p[0];
+                }
+                return count;
+            });
+        }
+        if (string("PermutationEngine/Count").find(options.filter) != string::npos) {
+            Run<Integer>("PermutationEngine/Count", n, [n] {
+                return PermutationEngine(n).Count([](const Permutation& p) { return p[0] == 0; });
+            });
+        }
+    }
+}
+
+void ParseOptions(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string key = argv[i];
+        string value = argv[i + 1];
+        if (key == "--sizes") {
+            options.sizes.clear();
+            stringstream stream(value);
+            string size;
+            while (getline(stream, size, ',')) {
+                options.sizes.push_back(stoul(size));
+            }
+        } else if (key == "--filter") {
+            options.filter = value;
+        } else if (key == "--min-time") {
+            options.min_time = stod(value);
+        } else {
+            cerr << "Unknown option " << key << endl;
+            exit(1);
+        }
+    }
+}
+
+void PrintRecords() {
+    cout << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto& record = records[i];
+        cout << (i ? "," : "") << "\n    {\"name\": \"" << record.name << "\", \"type\": \"" << record.type
+             << "\", \"size\": " << record.size << ", \"iterations\": " << record.iterations
+             << ", \"ns_per_op\": " << fixed << record.ns_per_op << "}";
+    }
+    cout << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    ParseOptions(argc, argv);
+    NullBuffer null_buffer;
+    streambuf* output = cout.rdbuf(&null_buffer);
+    BenchType<Integer>();
+    BenchType<IntegerMod>();
+    BenchType<Frac>();
+    BenchType<Float>();
+    BenchPermutations();
+    cout.rdbuf(output);
+    PrintRecords();
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include "exceptions.h"
+#include "matrix.h"
+#include "mymath.h"
+#include "myconcepts.h"
+#include "poly.h"
+#include "poly_gcd.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Minimal polynomial of a linearly recurrent sequence, O(N^2). Returns monic f
+// with sum f_j s[i + j] = 0 for all i; exact once the sequence has 2 * deg f terms
+template <Field T>
+Poly<T> BerlekampMassey(const std::vector<T>& sequence) {
+    std::vector<T> current = {T::ONE()};
+    std::vector<T> previous = {T::ONE()};
+    size_t length = 0;
+    size_t shift = 1;
+    T last = T::ONE();
+    for (size_t i = 0; i < sequence.size(); ++i) {
+        T discrepancy = sequence[i];
+        for (size_t j = 1; j <= length && j < current.size(); ++j) {
+            discrepancy += current[j] * sequence[i - j];
+        }
+        if (discrepancy == T::ZERO()) {
+            ++shift;
+            continue;
+        }
+        T coefficient = discrepancy / last;
+        std::vector<T> saved = current;
+        current.resize(std::max(current.size(), previous.size() + shift), T::ZERO());
+        for (size_t j = 0; j < previous.size(); ++j) {
+            current[j + shift] -= coefficient * previous[j];
+        }
+        if (2 * length <= i) {
+            length = i + 1 - length;
+            previous = std::move(saved);
+            last = discrepancy;
+            shift = 1;
+        } else {
+            ++shift;
+        }
+    }
+    // current is the connection polynomial 1 + c_1 x + ... + c_L x^L, the answer is its reverse
+    std::vector<T> ans(length + 1, T::ZERO());
+    for (size_t j = 0; j <= length && j < current.size(); ++j) {
+        ans[length - j] = current[j];
+    }
+    return Poly<T>(ans);
+}
+
+// Square operator known only by its action on vectors: sparse, structured or
+// just too big to store. Everything here is Wiedemann's method, so it takes O(n)
+// applications and O(n^2) field operations on top of them, with no elimination.
+// The answers are Monte Carlo: correct with high probability over a big field
+// such as IntegerModulo. Krylov sequences grow fast over Fraction<Integer>, so
+// there it's only usable for tiny operators
+template <Field T>
+class BlackBoxOperator {
+public:
+    using Action = std::function<Vector<T>(const Vector<T>&)>;
+
+    // transposed is optional, Rank is exact with high probability only if it's given
+    BlackBoxOperator(size_t n, Action apply, Action transposed = nullptr)
+        : n_(n), apply_(std::move(apply)), transposed_(std::move(transposed)) {}
+
+    BlackBoxOperator(const Matrix<T>& m) : n_(m.nsize()) {
+        if (m.nsize() != m.msize()) {
+            throw WrongSizeException();
+        }
+        auto data = std::make_shared<const Matrix<T>>(m);
+        apply_ = [data](const Vector<T>& v) {
+            Vector<T> ans(v.size());
+            for (size_t i = 0; i < v.size(); ++i) {
+                ans[i] = T::ZERO();
+                for (size_t j = 0; j < v.size(); ++j) {
+                    ans[i] += (*data)[i][j] * v[j];
+                }
+            }
+            return ans;
+        };
+        transposed_ = [data](const Vector<T>& v) {
+            Vector<T> ans(v.size());
+            for (size_t i = 0; i < v.size(); ++i) {
+                ans[i] = T::ZERO();
+                for (size_t j = 0; j < v.size(); ++j) {
+                    ans[i] += (*data)[j][i] * v[j];
+                }
+            }
+            return ans;
+        };
+    }
+
+    size_t size() const {
+        return n_;
+    }
+
+    Vector<T> Apply(const Vector<T>& v) const {
+        if (v.size() != n_) {
+            throw WrongSizeException();
+        }
+        Vector<T> ans = apply_(v);
+        if (ans.size() != n_) {
+            throw WrongSizeException();
+        }
+        return ans;
+    }
+
+    Vector<T> operator()(const Vector<T>& v) const {
+        return Apply(v);
+    }
+
+    // Each attempt projects the Krylov sequence of a random v on a random u and runs
+    // Berlekamp–Massey on 2n terms. The results divide the minimal polynomial, so
+    // their lcm is taken until it kills a fresh random vector
+    Poly<T> MinimalPoly() const {
+        std::mt19937 rng(n_);
+        return Wiedemann([this](const Vector<T>& v) { return Apply(v); }, rng);
+    }
+
+    // A * D for a random diagonal D has minimal polynomial equal to the
+    // characteristic one with high probability, then det A = (-1)^n f(0) / det D
+    friend T Det(const BlackBoxOperator& op) {
+        std::mt19937 rng(op.n_);
+        for (size_t attempt = 0; attempt < ATTEMPTS; ++attempt) {
+            std::vector<T> diagonal = op.RandomDiagonal(rng);
+            Poly<T> f = op.Wiedemann([&](const Vector<T>& v) {
+                return op.Apply(Scale(diagonal, v));
+            }, rng);
+            const auto& coefficients = f.GetCoefficients();
+            auto constant = coefficients.find(0);
+            if (constant == coefficients.end()) {
+                return T::ZERO(); // f divides the minimal polynomial, so 0 is an eigenvalue
+            }
+            if (f.deg() != op.n_) {
+                continue;
+            }
+            T ans = (op.n_ % 2 == 0 ? constant->second : -constant->second);
+            for (const auto& d : diagonal) {
+                ans /= d;
+            }
+            return ans;
+        }
+        throw RandomizationFailedException();
+    }
+
+    // With the transposed action, B = D1 A^T D2 A D1 has rank rk A and no nilpotent
+    // part with high probability, so rk A = deg minpoly(B) - 1 unless B is invertible.
+    // Without it A * D is used instead, which may underestimate but never overestimates
+    size_t Rank() const {
+        std::mt19937 rng(n_);
+        std::vector<T> left = RandomDiagonal(rng);
+        std::vector<T> middle = RandomDiagonal(rng);
+        Action preconditioned;
+        if (transposed_) {
+            preconditioned = [&](const Vector<T>& v) {
+                return Scale(left, Transposed(Scale(middle, Apply(Scale(left, v)))));
+            };
+        } else {
+            preconditioned = [&](const Vector<T>& v) {
+                return Apply(Scale(left, v));
+            };
+        }
+        Poly<T> f = Wiedemann(preconditioned, rng);
+        if (f.GetCoefficients().contains(0)) {
+            return n_;
+        }
+        return f.deg() - 1;
+    }
+
+private:
+    static constexpr size_t ATTEMPTS = 64;
+
+    Vector<T> Transposed(const Vector<T>& v) const {
+        Vector<T> ans = transposed_(v);
+        if (ans.size() != n_) {
+            throw WrongSizeException();
+        }
+        return ans;
+    }
+
+    Poly<T> Wiedemann(const Action& apply, std::mt19937& rng) const {
+        Poly<T> ans = Poly<T>::ONE();
+        for (size_t attempt = 0; attempt < ATTEMPTS; ++attempt) {
+            Vector<T> u = RandomVector(rng);
+            Vector<T> v = RandomVector(rng);
+            std::vector<T> sequence;
+            sequence.reserve(2 * n_);
+            for (size_t i = 0; i < 2 * n_; ++i) {
+                sequence.push_back(u * v);
+                if (i + 1 < 2 * n_) {
+                    v = apply(v);
+                }
+            }
+            Poly<T> f = BerlekampMassey(sequence);
+            ans = ans * f / gcd(ans, f);
+            if (Annihilates(ans, apply, RandomVector(rng))) {
+                return ans;
+            }
+        }
+        throw RandomizationFailedException();
+    }
+
+    // Whether f(A) w = 0, by Horner's rule in deg f applications
+    bool Annihilates(const Poly<T>& f, const Action& apply, const Vector<T>& w) const {
+        std::vector<T> coefficients(f.deg() + 1, T::ZERO());
+        for (const auto& [power, coefficient] : f.GetCoefficients()) {
+            coefficients[power] = coefficient;
+        }
+        Vector<T> result = w * coefficients.back();
+        for (size_t power = f.deg(); power-- > 0;) {
+            result = apply(result);
+            for (size_t i = 0; i < n_; ++i) {
+                result[i] += coefficients[power] * w[i];
+            }
+        }
+        for (size_t i = 0; i < n_; ++i) {
+            if (result[i] != T::ZERO()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static Vector<T> Scale(const std::vector<T>& diagonal, Vector<T> v) {
+        for (size_t i = 0; i < v.size(); ++i) {
+            v[i] *= diagonal[i];
+        }
+        return v;
+    }
+
+    // Uniform over the whole field for residues, small integers otherwise
+    static T RandomScalar(std::mt19937& rng) {
+        if constexpr (requires { T::Modulus(); }) {
+            return T(std::uniform_int_distribution<long long>(0, T::Modulus() - 1)(rng));
+        } else {
+            return FromInteger<T>(std::uniform_int_distribution<int>(-100, 100)(rng));
+        }
+    }
+
+    Vector<T> RandomVector(std::mt19937& rng) const {
+        Vector<T> ans(n_);
+        for (size_t i = 0; i < n_; ++i) {
+            ans[i] = RandomScalar(rng);
+        }
+        return ans;
+    }
+
+    std::vector<T> RandomDiagonal(std::mt19937& rng) const {
+        std::vector<T> ans(n_);
+        for (auto& d : ans) {
+            do {
+                d = RandomScalar(rng);
+            } while (d == T::ZERO());
+        }
+        return ans;
+    }
+
+    size_t n_;
+    Action apply_;
+    Action transposed_;
+};
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "black_box.h"
+#include "echelon_space.h"
+#include "exceptions.h"
+#include "integer_mod.h"
+#include "poly.h"
+#include "poly_gcd.h"
+#include "sparse_matrix.h"
+#include "thread_pool.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Linear systems and kernels of big sparse matrices modulo a prime, without
+// ever forming a dense matrix. A and A^T are kept in CSR, and the Krylov
+// iteration moves a block of s vectors at once: one pass over the nonzeros per
+// step for the whole block, rows split between threads, and the s projections
+// taken in parallel. Memory is O(nnz + n * s).
+// The s scalar sequences are combined with lcm of their Berlekamp–Massey
+// generators rather than a matrix generator, so the block buys robustness and
+// parallelism, not fewer steps: every call still takes about 2n block products
+template <long long MOD>
+class BlockWiedemann {
+public:
+    using T = IntegerModulo<MOD>;
+    using Block = std::vector<Vector<T>>;
+
+    BlockWiedemann(SparseMatrix<T> a, size_t block_size = ThreadPool::Global().size())
+        : a_(std::move(a)), transposed_(a_.Transpose()), block_size_(std::max<size_t>(1, block_size)) {}
+
+    size_t block_size() const {
+        return block_size_;
+    }
+
+    // x with A x = b for a nonsingular A. If f is the minimal polynomial of b
+    // then f(A) b = 0, and x = -(f(A) - f(0)) / (A f(0)) b. Throws
+    // SingularMatrixException when f(0) = 0, which proves A singular
+    Vector<T> Solve(const Vector<T>& b) const {
+        size_t n = a_.nsize();
+        if (n != a_.msize() || b.size() != n) {
+            throw WrongSizeException();
+        }
+        std::mt19937 rng(n);
+        auto apply = [this](const Block& v) { return a_ * v; };
+        Poly<T> f = Poly<T>::ONE();
+        for (size_t attempt = 0; attempt < ATTEMPTS; ++attempt) {
+            Poly<T> generator = Generator(apply, n, {b}, rng);
+            f = f * generator / gcd(f, generator);
+            std::vector<T> coefficients = Coefficients(f);
+            if (!IsZero(Evaluate(coefficients, apply, {b}))) {
+                continue;
+            }
+            if (coefficients[0] == T::ZERO()) {
+                throw SingularMatrixException();
+            }
+            coefficients.erase(coefficients.begin());
+            return Evaluate(coefficients, apply, {b})[0] * (-T::ONE() / f.GetCoefficients().at(0));
+        }
+        throw RandomizationFailedException();
+    }
+
+    // Basis of {x : A x = 0}. Works with B = D1 A^T D2 A D1 for random diagonal
+    // D1, D2: its kernel is D1^-1 ker A, and 0 is a simple root of its minimal
+    // polynomial f = x g with high probability, so g(B) w is a random kernel
+    // vector. Throws RandomizationFailedException if the random vectors don't
+    // add up to the whole kernel
+    EchelonSpace<T> Kernel() const {
+        size_t m = a_.msize();
+        std::mt19937 rng(m);
+        std::vector<T> left = RandomDiagonal(m, rng);
+        std::vector<T> middle = RandomDiagonal(a_.nsize(), rng);
+        auto apply = [&](const Block& v) {
+            return Scale(left, transposed_ * Scale(middle, a_ * Scale(left, v)));
+        };
+        Poly<T> f = Poly<T>::ONE();
+        for (size_t attempt = 0;; ++attempt) {
+            if (attempt == ATTEMPTS) {
+                throw RandomizationFailedException();
+            }
+            Poly<T> generator = Generator(apply, m, RandomBlock(m, rng), rng);
+            f = f * generator / gcd(f, generator);
+            if (IsZero(Evaluate(Coefficients(f), apply, RandomBlock(m, rng)))) {
+                break;
+            }
+        }
+        EchelonSpace<T> ans(m);
+        std::vector<T> coefficients = Coefficients(f);
+        if (coefficients[0] != T::ZERO()) {
+            return ans;
+        }
+        coefficients.erase(coefficients.begin());
+        size_t dim = m + 1 - coefficients.size();
+        for (size_t attempt = 0; attempt < ATTEMPTS && ans.dim() < dim; ++attempt) {
+            Block candidates = Scale(left, Evaluate(coefficients, apply, RandomBlock(m, rng)));
+            Block images = a_ * candidates;
+            bool progress = false;
+            for (size_t l = 0; l < candidates.size(); ++l) {
+                if (IsZero({images[l]}) && ans.Insert(candidates[l])) {
+                    progress = true;
+                }
+            }
+            if (!progress) {
+                break;
+            }
+        }
+        // A short basis would pass for the whole kernel, so running out of
+        // luck is an error, like in Solve
+        if (ans.dim() < dim) {
+            throw RandomizationFailedException();
+        }
+        return ans;
+    }
+
+private:
+    static constexpr size_t ATTEMPTS = 64;
+
+    // lcm of the generators of u_l^T B^i v_(l mod starts), i < 2n, for a random block u
+    template <typename Apply>
+    Poly<T> Generator(const Apply& apply, size_t n, Block v, std::mt19937& rng) const {
+        Block u = RandomBlock(n, rng);
+        std::vector<std::vector<T>> sequences(block_size_);
+        for (auto& sequence : sequences) {
+            sequence.reserve(2 * n);
+        }
+        for (size_t i = 0; i < 2 * n; ++i) {
+            ThreadPool::Global().ParallelFor(block_size_, [&](size_t l) {
+                sequences[l].push_back(u[l] * v[l % v.size()]);
+            });
+            if (i + 1 < 2 * n) {
+                v = apply(v);
+            }
+        }
+        Poly<T> ans = Poly<T>::ONE();
+        for (const auto& sequence : sequences) {
+            Poly<T> generator = BerlekampMassey(sequence);
+            ans = ans * generator / gcd(ans, generator);
+        }
+        return ans;
+    }
+
+    // sum c_i B^i w for every w of the block, by Horner's rule
+    template <typename Apply>
+    static Block Evaluate(const std::vector<T>& coefficients, const Apply& apply, const Block& w) {
+        Block ans(w.size(), Vector<T>(w[0].size()));
+        for (size_t power = coefficients.size(); power-- > 0;) {
+            if (power + 1 != coefficients.size()) {
+                ans = apply(ans);
+            }
+            for (size_t l = 0; l < w.size(); ++l) {
+                for (size_t i = 0; i < w[l].size(); ++i) {
+                    ans[l][i] += coefficients[power] * w[l][i];
+                }
+            }
+        }
+        return ans;
+    }
+
+    static std::vector<T> Coefficients(const Poly<T>& f) {
+        std::vector<T> ans(f.deg() + 1, T::ZERO());
+        for (const auto& [power, coefficient] : f.GetCoefficients()) {
+            ans[power] = coefficient;
+        }
+        return ans;
+    }
+
+    static bool IsZero(const Block& block) {
+        for (const auto& v : block) {
+            for (size_t i = 0; i < v.size(); ++i) {
+                if (v[i] != T::ZERO()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static Block Scale(const std::vector<T>& diagonal, Block block) {
+        for (auto& v : block) {
+            for (size_t i = 0; i < v.size(); ++i) {
+                v[i] *= diagonal[i];
+            }
+        }
+        return block;
+    }
+
+    static T Random(std::mt19937& rng) {
+        return T(std::uniform_int_distribution<long long>(0, MOD - 1)(rng));
+    }
+
+    Block RandomBlock(size_t n, std::mt19937& rng) const {
+        Block ans(block_size_, Vector<T>(n));
+        for (auto& v : ans) {
+            for (size_t i = 0; i < n; ++i) {
+                v[i] = Random(rng);
+            }
+        }
+        return ans;
+    }
+
+    static std::vector<T> RandomDiagonal(size_t n, std::mt19937& rng) {
+        std::vector<T> ans(n);
+        for (auto& d : ans) {
+            do {
+                d = Random(rng);
+            } while (d == T::ZERO());
+        }
+        return ans;
+    }
+
+    SparseMatrix<T> a_;
+    SparseMatrix<T> transposed_;
+    size_t block_size_;
+};
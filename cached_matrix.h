@@ -0,0 +1,179 @@
+#pragma once
+
+#include "exceptions.h"
+#include "matrix.h"
+#include "myconcepts.h"
+#include "poly.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Matrix that remembers what was computed from it: Det, rank, reduced echelon
+// form with pivots and CharPoly are computed on first request and kept until
+// the matrix changes. Entries are only written through Set and the in-place
+// operators, which drop all of it; reads, from a const object or not, keep it
+template <RingWithOne T>
+class CachedMatrix {
+public:
+    struct CacheStats {
+        size_t hits;
+        size_t misses;
+
+        double HitRate() const {
+            return hits + misses == 0 ? 0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+        }
+    };
+
+    CachedMatrix(Matrix<T> data) : data_(std::move(data)) {}
+    CachedMatrix(size_t n, size_t m) : data_(n, m) {}
+    CachedMatrix(const CachedMatrix& other) : data_(other.data_) {
+        CopyCaches(other);
+    }
+    CachedMatrix& operator=(const CachedMatrix& other) {
+        data_ = other.data_;
+        CopyCaches(other);
+        return *this;
+    }
+
+    size_t nsize() const {
+        return data_.nsize();
+    }
+    size_t msize() const {
+        return data_.msize();
+    }
+
+    const Matrix<T>& GetMatrix() const {
+        return data_;
+    }
+
+    const std::vector<T>& operator[](size_t pos) const {
+        return data_[pos];
+    }
+
+    const T& At(size_t i, size_t j) const {
+        return data_[i][j];
+    }
+
+    void Set(size_t i, size_t j, T value) {
+        Invalidate();
+        data_[i][j] = std::move(value);
+    }
+
+    CachedMatrix& operator+=(const Matrix<T>& other) {
+        Invalidate();
+        data_ += other;
+        return *this;
+    }
+    CachedMatrix& operator-=(const Matrix<T>& other) {
+        Invalidate();
+        data_ -= other;
+        return *this;
+    }
+    CachedMatrix& operator*=(const Matrix<T>& other) {
+        Invalidate();
+        data_ = data_ * other;
+        return *this;
+    }
+    CachedMatrix& operator*=(const T& lambda) {
+        Invalidate();
+        data_ *= lambda;
+        return *this;
+    }
+
+    friend T Det(const CachedMatrix& matrix) {
+        return matrix.Cached(matrix.det_, [&matrix] {
+            return Det(matrix.data_);
+        });
+    }
+
+    const Poly<T>& CharPoly() const {
+        return Cached(char_poly_, [this] {
+            return data_.CharPoly();
+        });
+    }
+
+    // Unlike Matrix::rk works for rectangular matrices too
+    size_t rk() const requires Field<T> {
+        return GetPivots().size();
+    }
+
+    const Matrix<T>& GetEchelonForm() const requires Field<T> {
+        return GetEchelon().form;
+    }
+
+    // Column of the leading one in every nonzero row of the echelon form
+    const std::vector<size_t>& GetPivots() const requires Field<T> {
+        return GetEchelon().pivots;
+    }
+
+    CacheStats GetCacheStats() const {
+        return {hits_.load(), misses_.load()};
+    }
+
+    void ResetCacheStats() {
+        hits_ = 0;
+        misses_ = 0;
+    }
+
+private:
+    struct Echelon {
+        Matrix<T> form;
+        std::vector<size_t> pivots;
+    };
+
+    const Echelon& GetEchelon() const {
+        return Cached(echelon_, [this] {
+            Echelon ans{data_, {}};
+            ans.form.Gauss();
+            for (size_t i = 0, j = 0; i < nsize(); ++i) {
+                while (j < msize() && ans.form[i][j] == T::ZERO()) {
+                    ++j;
+                }
+                if (j == msize()) {
+                    break;
+                }
+                ans.pivots.push_back(j);
+            }
+            return ans;
+        });
+    }
+
+    // Same lock-free pattern as the caches of Permutation and LinearOperator:
+    // concurrent readers may both compute, the first stored value wins
+    template <typename V, typename F>
+    const V& Cached(std::shared_ptr<const V>& slot, F compute) const {
+        auto value = std::atomic_load(&slot);
+        if (value) {
+            ++hits_;
+            return *value;
+        }
+        ++misses_;
+        std::shared_ptr<const V> expected;
+        std::atomic_compare_exchange_strong(&slot, &expected, std::shared_ptr<const V>(std::make_shared<V>(compute())));
+        return *std::atomic_load(&slot);
+    }
+
+    void Invalidate() {
+        det_.reset();
+        char_poly_.reset();
+        echelon_.reset();
+    }
+
+    void CopyCaches(const CachedMatrix& other) {
+        det_ = std::atomic_load(&other.det_);
+        char_poly_ = std::atomic_load(&other.char_poly_);
+        echelon_ = std::atomic_load(&other.echelon_);
+        hits_ = other.hits_.load();
+        misses_ = other.misses_.load();
+    }
+
+    Matrix<T> data_;
+    mutable std::shared_ptr<const T> det_;
+    mutable std::shared_ptr<const Poly<T>> char_poly_;
+    mutable std::shared_ptr<const Echelon> echelon_;
+    mutable std::atomic<size_t> hits_ = 0;
+    mutable std::atomic<size_t> misses_ = 0;
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "mymath.h"
+#include "myconcepts.h"
+
+#include <array>
+#include <atomic>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+enum class Operation {
+    Addition,
+    Subtraction,
+    Negation,
+    Multiplication,
+    Division,
+    Remainder,
+    Comparison,
+    Gcd,
+    Copy,
+};
+
+inline constexpr size_t OPERATIONS = static_cast<size_t>(Operation::Copy) + 1;
+
+struct OperationCounts {
+    std::array<size_t, OPERATIONS> counts = {};
+
+    size_t operator[](Operation operation) const {
+        return counts[static_cast<size_t>(operation)];
+    }
+
+    OperationCounts operator-(const OperationCounts& other) const {
+        OperationCounts ans;
+        for (size_t i = 0; i < OPERATIONS; ++i) {
+            ans.counts[i] = counts[i] - other.counts[i];
+        }
+        return ans;
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const OperationCounts& counts) {
+        static const char* names[OPERATIONS] = {
+            "additions", "subtractions", "negations", "multiplications", "divisions",
+            "remainders", "comparisons", "gcds", "copies"};
+        for (size_t i = 0; i < OPERATIONS; ++i) {
+            out << (i ? ", " : "") << names[i] << ": " << counts.counts[i];
+        }
+        return out;
+    }
+};
+
+// Every thread counts into its own block, so recording is an uncontended
+// relaxed increment. Blocks are registered once and outlive their threads, so
+// work done inside a ThreadPool is still in the total
+class OperationRegistry {
+public:
+    static void Record(Operation operation) {
+        Local()[static_cast<size_t>(operation)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Sum over all threads
+    static OperationCounts Total() {
+        OperationCounts ans;
+        std::lock_guard lock(Mutex());
+        for (const auto& counters : Blocks()) {
+            for (size_t i = 0; i < OPERATIONS; ++i) {
+                ans.counts[i] += (*counters)[i].load(std::memory_order_relaxed);
+            }
+        }
+        return ans;
+    }
+
+private:
+    using Counters = std::array<std::atomic<size_t>, OPERATIONS>;
+
+    static Counters& Local() {
+        thread_local std::shared_ptr<Counters> counters = Register();
+        return *counters;
+    }
+
+    static std::shared_ptr<Counters> Register() {
+        auto counters = std::make_shared<Counters>();
+        for (auto& counter : *counters) {
+            counter = 0;
+        }
+        std::lock_guard lock(Mutex());
+        Blocks().push_back(counters);
+        return counters;
+    }
+
+    static std::mutex& Mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<std::shared_ptr<Counters>>& Blocks() {
+        static std::vector<std::shared_ptr<Counters>> blocks;
+        return blocks;
+    }
+};
+
+// Counts the operations on Counted values done between construction and Get():
+//     OperationCounter counter;
+//     Det(matrix);
+//     std::cout << counter.Get();
+// Other threads doing unrelated work in the meantime are counted too
+class OperationCounter {
+public:
+    OperationCounter() : start_(OperationRegistry::Total()) {}
+
+    OperationCounts Get() const {
+        return OperationRegistry::Total() - start_;
+    }
+
+    void Reset() {
+        start_ = OperationRegistry::Total();
+    }
+
+private:
+    OperationCounts start_;
+};
+
+// T that records every arithmetic operation, comparison, gcd and copy made on
+// it. It is a RingWithOne, EuclideanRing or Field exactly when T is, so any
+// algorithm of the library can run on it unchanged. Copies are what is
+// counted in place of allocations: they're where types like Poly or big
+// fractions allocate
+template <RingWithOne T>
+class Counted {
+public:
+    Counted() : value_(T::ZERO()) {}
+    Counted(const T& value) : value_(value) {}
+    template <typename U>
+        requires(!std::same_as<std::remove_cvref_t<U>, T> && !std::same_as<std::remove_cvref_t<U>, Counted> &&
+                 std::constructible_from<T, U>)
+    Counted(U&& value) : value_(std::forward<U>(value)) {}
+
+    Counted(const Counted& other) : value_(other.value_) {
+        OperationRegistry::Record(Operation::Copy);
+    }
+    Counted(Counted&& other) = default;
+    Counted& operator=(const Counted& other) {
+        OperationRegistry::Record(Operation::Copy);
+        value_ = other.value_;
+        return *this;
+    }
+    Counted& operator=(Counted&& other) = default;
+
+    const T& value() const {
+        return value_;
+    }
+
+    bool operator==(const Counted& other) const {
+        OperationRegistry::Record(Operation::Comparison);
+        return value_ == other.value_;
+    }
+    bool operator!=(const Counted& other) const {
+        return !operator==(other);
+    }
+    auto operator<=>(const Counted& other) const requires std::three_way_comparable<T> {
+        OperationRegistry::Record(Operation::Comparison);
+        return value_ <=> other.value_;
+    }
+
+    Counted operator+(const Counted& other) const {
+        OperationRegistry::Record(Operation::Addition);
+        return Counted(value_ + other.value_);
+    }
+    Counted operator-(const Counted& other) const {
+        OperationRegistry::Record(Operation::Subtraction);
+        return Counted(value_ - other.value_);
+    }
+    Counted operator*(const Counted& other) const {
+        OperationRegistry::Record(Operation::Multiplication);
+        return Counted(value_ * other.value_);
+    }
+    Counted operator/(const Counted& other) const requires requires(T a, T b) { a / b; } {
+        OperationRegistry::Record(Operation::Division);
+        return Counted(value_ / other.value_);
+    }
+    Counted operator%(const Counted& other) const requires requires(T a, T b) { a % b; } {
+        OperationRegistry::Record(Operation::Remainder);
+        return Counted(value_ % other.value_);
+    }
+    Counted operator-() const {
+        OperationRegistry::Record(Operation::Negation);
+        return Counted(-value_);
+    }
+
+    Counted& operator+=(const Counted& other) {
+        OperationRegistry::Record(Operation::Addition);
+        value_ += other.value_;
+        return *this;
+    }
+    Counted& operator-=(const Counted& other) {
+        OperationRegistry::Record(Operation::Subtraction);
+        value_ -= other.value_;
+        return *this;
+    }
+    Counted& operator*=(const Counted& other) {
+        OperationRegistry::Record(Operation::Multiplication);
+        value_ *= other.value_;
+        return *this;
+    }
+    Counted& operator/=(const Counted& other) requires requires(T a, T b) { a / b; } {
+        OperationRegistry::Record(Operation::Division);
+        value_ /= other.value_;
+        return *this;
+    }
+    Counted& operator%=(const Counted& other) requires requires(T a, T b) { a % b; } {
+        OperationRegistry::Record(Operation::Remainder);
+        value_ %= other.value_;
+        return *this;
+    }
+
+    // One gcd, whatever it costs inside T
+    friend Counted gcd(const Counted& a, const Counted& b) requires EuclideanRing<T> {
+        OperationRegistry::Record(Operation::Gcd);
+        return Counted(gcd(a.value_, b.value_));
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const Counted& c) {
+        out << c.value_;
+        return out;
+    }
+
+    static Counted ZERO() {
+        return Counted(T::ZERO());
+    }
+    static Counted ONE() {
+        return Counted(T::ONE());
+    }
+
+private:
+    T value_;
+};
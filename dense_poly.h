@@ -0,0 +1,235 @@
+#pragma once
+
+#include "myconcepts.h"
+#include "poly.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Polynomial with coefficients stored contiguously starting from x^0.
+// Poly keeps a sparse map, which is nice for printing, but long division and
+// gcd of big polynomials need random access and subquadratic products
+template <RingWithOne T>
+class DensePoly {
+public:
+    DensePoly() {}
+    DensePoly(const DensePoly& other) = default;
+    DensePoly(DensePoly&& other) = default;
+    DensePoly& operator=(const DensePoly& other) = default;
+    DensePoly& operator=(DensePoly&& other) = default;
+
+    DensePoly(const T& coefficient) : data_(1, coefficient) {
+        Clean();
+    }
+    DensePoly(std::vector<T> coefficients) : data_(std::move(coefficients)) {
+        Clean();
+    }
+    DensePoly(const Poly<T>& poly) {
+        if (poly == Poly<T>::ZERO()) {
+            return;
+        }
+        data_.assign(poly.deg() + 1, T::ZERO());
+        for (const auto& [power, coefficient] : poly.GetCoefficients()) {
+            data_[power] = coefficient;
+        }
+    }
+
+    Poly<T> ToPoly() const {
+        return Poly<T>(data_);
+    }
+
+    bool operator==(const DensePoly& other) const = default;
+    bool operator!=(const DensePoly& other) const = default;
+
+    // Unlike Poly::deg, the zero polynomial has degree -1
+    ptrdiff_t deg() const {
+        return static_cast<ptrdiff_t>(data_.size()) - 1;
+    }
+
+    T SeniorCoefficient() const {
+        if (data_.empty()) return T::ZERO();
+        return data_.back();
+    }
+
+    T operator[](size_t power) const {
+        return power < data_.size() ? data_[power] : T::ZERO();
+    }
+
+    const std::vector<T>& GetCoefficients() const {
+        return data_;
+    }
+
+    DensePoly operator+(const DensePoly& other) const {
+        DensePoly ans(*this);
+        if (ans.data_.size() < other.data_.size()) {
+            ans.data_.resize(other.data_.size(), T::ZERO());
+        }
+        for (size_t i = 0; i < other.data_.size(); ++i) {
+            ans.data_[i] += other.data_[i];
+        }
+        ans.Clean();
+        return ans;
+    }
+    DensePoly operator-() const {
+        DensePoly ans(*this);
+        for (auto& coefficient : ans.data_) {
+            coefficient = -coefficient;
+        }
+        return ans;
+    }
+    DensePoly operator-(const DensePoly& other) const {
+        DensePoly ans(*this);
+        if (ans.data_.size() < other.data_.size()) {
+            ans.data_.resize(other.data_.size(), T::ZERO());
+        }
+        for (size_t i = 0; i < other.data_.size(); ++i) {
+            ans.data_[i] -= other.data_[i];
+        }
+        ans.Clean();
+        return ans;
+    }
+    DensePoly operator*(const DensePoly& other) const {
+        if (data_.empty() || other.data_.empty()) {
+            return DensePoly();
+        }
+        std::vector<T> ans(data_.size() + other.data_.size() - 1, T::ZERO());
+        Multiply(data_.data(), data_.size(), other.data_.data(), other.data_.size(), ans.data());
+        return DensePoly(std::move(ans));
+    }
+
+    // Quotient and remainder in one pass
+    std::pair<DensePoly, DensePoly> DivMod(const DensePoly& other) const requires Field<T> {
+        ptrdiff_t n = deg();
+        ptrdiff_t m = other.deg();
+        if (n < m) {
+            return {DensePoly(), *this};
+        }
+        std::vector<T> rest = data_;
+        std::vector<T> quotient(n - m + 1, T::ZERO());
+        T inverse = T::ONE() / other.data_.back();
+        for (ptrdiff_t i = n - m; i >= 0; --i) {
+            T coefficient = rest[i + m] * inverse;
+            rest[i + m] = T::ZERO();
+            if (coefficient == T::ZERO()) {
+                continue;
+            }
+            quotient[i] = coefficient;
+            for (ptrdiff_t j = 0; j < m; ++j) {
+                rest[i + j] -= coefficient * other.data_[j];
+            }
+        }
+        rest.resize(m);
+        return {DensePoly(std::move(quotient)), DensePoly(std::move(rest))};
+    }
+
+    DensePoly operator/(const DensePoly& other) const requires Field<T> {
+        return DivMod(other).first;
+    }
+    DensePoly operator%(const DensePoly& other) const requires Field<T> {
+        return DivMod(other).second;
+    }
+    DensePoly operator/(const T& lambda) const requires Field<T> {
+        DensePoly ans(*this);
+        for (auto& coefficient : ans.data_) {
+            coefficient /= lambda;
+        }
+        return ans;
+    }
+
+    // Quotient of division by x^k
+    DensePoly ShiftRight(size_t k) const {
+        if (k >= data_.size()) {
+            return DensePoly();
+        }
+        return DensePoly(std::vector<T>(data_.begin() + k, data_.end()));
+    }
+
+    static DensePoly ZERO() {
+        return DensePoly();
+    }
+    static DensePoly ONE() {
+        return DensePoly(T::ONE());
+    }
+
+    // out[0, n + m - 1) += a[0, n) * b[0, m)
+    static void Multiply(const T* a, size_t n, const T* b, size_t m, T* out) {
+        if (n < m) {
+            std::swap(a, b);
+            std::swap(n, m);
+        }
+        if (m <= KARATSUBA_THRESHOLD) {
+            Schoolbook(a, n, b, m, out);
+            return;
+        }
+        // Cut the longer operand into pieces of the shorter one's length
+        std::vector<T> piece(m, T::ZERO());
+        std::vector<T> product(2 * m, T::ZERO());
+        for (size_t start = 0; start < n; start += m) {
+            size_t len = std::min(m, n - start);
+            std::copy(a + start, a + start + len, piece.begin());
+            std::fill(piece.begin() + len, piece.end(), T::ZERO());
+            std::fill(product.begin(), product.end(), T::ZERO());
+            Karatsuba(piece.data(), b, m, product.data());
+            for (size_t i = 0; i + 1 < len + m; ++i) {
+                out[start + i] += product[i];
+            }
+        }
+    }
+
+private:
+    static const size_t KARATSUBA_THRESHOLD = 32;
+
+    static void Schoolbook(const T* a, size_t n, const T* b, size_t m, T* out) {
+        for (size_t i = 0; i < n; ++i) {
+            if (a[i] == T::ZERO()) {
+                continue;
+            }
+            for (size_t j = 0; j < m; ++j) {
+                out[i + j] += a[i] * b[j];
+            }
+        }
+    }
+
+    // out[0, 2n) += a[0, n) * b[0, n)
+    static void Karatsuba(const T* a, const T* b, size_t n, T* out) {
+        if (n <= KARATSUBA_THRESHOLD) {
+            Schoolbook(a, n, b, n, out);
+            return;
+        }
+        size_t low = n / 2;
+        size_t high = n - low;
+        std::vector<T> z0(2 * low, T::ZERO());
+        std::vector<T> z1(2 * high, T::ZERO());
+        std::vector<T> z2(2 * high, T::ZERO());
+        Karatsuba(a, b, low, z0.data());
+        Karatsuba(a + low, b + low, high, z2.data());
+        std::vector<T> sum_a(a + low, a + n);
+        std::vector<T> sum_b(b + low, b + n);
+        for (size_t i = 0; i < low; ++i) {
+            sum_a[i] += a[i];
+            sum_b[i] += b[i];
+        }
+        Karatsuba(sum_a.data(), sum_b.data(), high, z1.data());
+        for (size_t i = 0; i < 2 * low; ++i) {
+            z1[i] -= z0[i];
+            out[i] += z0[i];
+        }
+        for (size_t i = 0; i < 2 * high; ++i) {
+            z1[i] -= z2[i];
+            out[i + 2 * low] += z2[i];
+        }
+        for (size_t i = 0; i < 2 * high; ++i) {
+            out[i + low] += z1[i];
+        }
+    }
+
+    void Clean() {
+        while (!data_.empty() && data_.back() == T::ZERO()) {
+            data_.pop_back();
+        }
+    }
+
+    std::vector<T> data_;
+};
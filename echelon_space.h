@@ -0,0 +1,185 @@
+#pragma once
+
+#include "exceptions.h"
+#include "myconcepts.h"
+#include "vector.h"
+#include "vector_space.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Subspace kept as a reduced row echelon basis which is updated vector by vector.
+// Insert and Contains cost O(n * dim) and never rebuild a matrix, so a span of
+// many generators is built in one pass instead of rerunning Gauss
+template <Field T>
+class EchelonSpace {
+public:
+    EchelonSpace(size_t n) : n_(n) {}
+    EchelonSpace(size_t n, const std::vector<Vector<T>>& vectors) : n_(n) {
+        for (const auto& vec : vectors) {
+            Insert(vec);
+        }
+    }
+    EchelonSpace(const VectorSpace<T>& space) : EchelonSpace(space.vector_size(), space.GetBasis()) {}
+
+    size_t dim() const {
+        return rows_.size();
+    }
+
+    size_t vector_size() const {
+        return n_;
+    }
+
+    // Rows of the reduced echelon form, sorted by pivot
+    const std::vector<Vector<T>>& GetBasis() const {
+        return rows_;
+    }
+
+    const std::vector<size_t>& GetPivots() const {
+        return pivots_;
+    }
+
+    // What is left of v after eliminating all pivots, zero iff v lies in the space
+    Vector<T> Reduce(Vector<T> v) const {
+        if (v.size() != n_) {
+            throw WrongSizeException();
+        }
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            T lambda = v[pivots_[i]];
+            if (lambda == T::ZERO()) {
+                continue;
+            }
+            for (size_t j = pivots_[i]; j < n_; ++j) {
+                v[j] -= lambda * rows_[i][j];
+            }
+        }
+        return v;
+    }
+
+    bool Contains(const Vector<T>& v) const {
+        return FirstNonZero(Reduce(v)) == n_;
+    }
+
+    // Returns false if v was already in the space
+    bool Insert(const Vector<T>& v) {
+        Vector<T> rest = Reduce(v);
+        size_t pivot = FirstNonZero(rest);
+        if (pivot == n_) {
+            return false;
+        }
+        T inverse = T::ONE() / rest[pivot];
+        for (size_t j = pivot; j < n_; ++j) {
+            rest[j] *= inverse;
+        }
+        // Keep the form reduced: clear the new pivot column in the old rows
+        for (auto& row : rows_) {
+            T lambda = row[pivot];
+            if (lambda == T::ZERO()) {
+                continue;
+            }
+            for (size_t j = pivot; j < n_; ++j) {
+                row[j] -= lambda * rest[j];
+            }
+        }
+        size_t pos = std::lower_bound(pivots_.begin(), pivots_.end(), pivot) - pivots_.begin();
+        pivots_.insert(pivots_.begin() + pos, pivot);
+        rows_.insert(rows_.begin() + pos, std::move(rest));
+        return true;
+    }
+
+    EchelonSpace operator+(const EchelonSpace& other) const {
+        EchelonSpace ans = *this;
+        ans += other;
+        return ans;
+    }
+
+    EchelonSpace& operator+=(const EchelonSpace& other) {
+        if (n_ != other.n_) {
+            throw WrongSizeException();
+        }
+        for (const auto& row : other.rows_) {
+            Insert(row);
+        }
+        return *this;
+    }
+
+    // Zassenhaus on top of the echelon form: the rows (u | u) are already reduced,
+    // so only the rows (w | 0) of other have to be eliminated
+    std::pair<EchelonSpace, EchelonSpace> SumAndIntersection(const EchelonSpace& other) const {
+        if (n_ != other.n_) {
+            throw WrongSizeException();
+        }
+        EchelonSpace doubled(2 * n_);
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            Vector<T> row(2 * n_);
+            for (size_t j = 0; j < n_; ++j) {
+                row[j] = rows_[i][j];
+                row[j + n_] = rows_[i][j];
+            }
+            doubled.pivots_.push_back(pivots_[i]);
+            doubled.rows_.push_back(std::move(row));
+        }
+        for (const auto& w : other.rows_) {
+            Vector<T> row(2 * n_);
+            for (size_t j = 0; j < n_; ++j) {
+                row[j] = w[j];
+            }
+            doubled.Insert(row);
+        }
+        EchelonSpace sum(n_);
+        EchelonSpace intersection(n_);
+        for (size_t i = 0; i < doubled.rows_.size(); ++i) {
+            bool left = doubled.pivots_[i] < n_;
+            Vector<T> row(n_);
+            for (size_t j = 0; j < n_; ++j) {
+                row[j] = doubled.rows_[i][j + (left ? 0 : n_)];
+            }
+            EchelonSpace& target = (left ? sum : intersection);
+            target.pivots_.push_back(doubled.pivots_[i] - (left ? 0 : n_));
+            target.rows_.push_back(std::move(row));
+        }
+        return {std::move(sum), std::move(intersection)};
+    }
+
+    EchelonSpace inter(const EchelonSpace& other) const {
+        return SumAndIntersection(other).second;
+    }
+
+    bool operator==(const EchelonSpace& other) const {
+        return n_ == other.n_ && pivots_ == other.pivots_ && rows_ == other.rows_;
+    }
+
+    // Rows in echelon form are linearly independent already
+    VectorSpace<T> ToVectorSpace() const {
+        return VectorSpace<T>::FromBasis(rows_);
+    }
+
+private:
+    size_t FirstNonZero(const Vector<T>& v) const {
+        for (size_t j = 0; j < n_; ++j) {
+            if (v[j] != T::ZERO()) {
+                return j;
+            }
+        }
+        return n_;
+    }
+
+    size_t n_;
+    std::vector<Vector<T>> rows_;
+    std::vector<size_t> pivots_;
+};
+
+// Intersection of many subspaces, every step starts from the reduced form of the previous one
+template <Field T>
+EchelonSpace<T> Intersection(const std::vector<EchelonSpace<T>>& spaces) {
+    if (spaces.empty()) {
+        throw WrongSizeException();
+    }
+    EchelonSpace<T> ans = spaces[0];
+    for (size_t i = 1; i < spaces.size() && ans.dim() != 0; ++i) {
+        ans = ans.inter(spaces[i]);
+    }
+    return ans;
+}
@@ -16,3 +16,44 @@ public:
     }
 };
 
+class DivisionByZeroException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Division by zero";
+    }
+};
+
+class RandomizationFailedException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Randomized algorithm failed too many times";
+    }
+};
+
+class FormatException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Malformed input";
+    }
+};
+
+class MemoryBudgetException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Memory budget is too small";
+    }
+};
+
+class OperationCancelledException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Operation was cancelled";
+    }
+};
+
+class DeadlineExceededException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Operation ran past its deadline";
+    }
+};
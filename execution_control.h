@@ -0,0 +1,83 @@
+#pragma once
+
+#include "exceptions.h"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <stop_token>
+
+// Cooperative cancellation, deadlines and progress for long computations.
+// An ExecutionScope makes a control current on its thread, ParallelFor hands
+// it on to the threads that help, and the elimination loops call
+// CheckExecution / ReportProgress, which throw OperationCancelledException or
+// DeadlineExceededException once the computation should stop. Without a
+// current control both are a thread-local load and a branch
+struct ExecutionControl {
+    using Clock = std::chrono::steady_clock;
+    // stage is the name used by TRACE_SPAN. Called from whatever thread made
+    // the progress, possibly from several at once
+    using ProgressCallback = std::function<void(const char* stage, size_t done, size_t total)>;
+
+    std::stop_token stop;
+    std::optional<Clock::time_point> deadline;
+    ProgressCallback progress;
+
+    void Check() const {
+        if (stop.stop_requested()) {
+            throw OperationCancelledException();
+        }
+        if (deadline && Clock::now() >= *deadline) {
+            throw DeadlineExceededException();
+        }
+    }
+
+    void Report(const char* stage, size_t done, size_t total) const {
+        Check();
+        if (progress) {
+            progress(stage, done, total);
+        }
+    }
+
+    static const ExecutionControl* Current() {
+        return CurrentSlot();
+    }
+
+private:
+    friend class ExecutionScope;
+
+    static const ExecutionControl*& CurrentSlot() {
+        thread_local const ExecutionControl* control = nullptr;
+        return control;
+    }
+};
+
+// Makes control (which may be null) current on this thread until destroyed
+class ExecutionScope {
+public:
+    explicit ExecutionScope(const ExecutionControl* control) : previous_(ExecutionControl::CurrentSlot()) {
+        ExecutionControl::CurrentSlot() = control;
+    }
+    ExecutionScope(const ExecutionScope& other) = delete;
+    ExecutionScope& operator=(const ExecutionScope& other) = delete;
+
+    ~ExecutionScope() {
+        ExecutionControl::CurrentSlot() = previous_;
+    }
+
+private:
+    const ExecutionControl* previous_;
+};
+
+inline void CheckExecution() {
+    if (const ExecutionControl* control = ExecutionControl::Current()) {
+        control->Check();
+    }
+}
+
+inline void ReportProgress(const char* stage, size_t done, size_t total) {
+    if (const ExecutionControl* control = ExecutionControl::Current()) {
+        control->Report(stage, done, total);
+    }
+}
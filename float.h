@@ -3,6 +3,7 @@
 #include <compare>
 #include <iostream>
 
+#include "format.h"
 #include "mymath.h"
 
 class Float {
@@ -20,9 +21,11 @@ public:
     }
 
     Float(double num): data_(num) {
-        if (std::abs(num) < EPS) { // Gets rid of -0s
-            data_ = 0;
-        }
+        Clean();
+    }
+
+    explicit operator double() const {
+        return data_;
     }
 
     bool operator==(const Float& other) const {
@@ -57,16 +60,28 @@ public:
         return Float(-data_);
     }
     Float& operator+=(const Float& other) {
-        return *this = *this + other;
+        data_ += other.data_;
+        Clean();
+        return *this;
     }
     Float& operator-=(const Float& other) {
-        return *this = *this - other;
+        data_ -= other.data_;
+        Clean();
+        return *this;
     }
     Float& operator*=(const Float& other) {
-        return *this = *this * other;
+        data_ *= other.data_;
+        Clean();
+        return *this;
     }
     Float& operator/=(const Float& other) {
-        return *this = *this / other;
+        data_ /= other.data_;
+        Clean();
+        return *this;
+    }
+
+    friend void FormatTo(std::string& buffer, const Float& i) {
+        FormatTo(buffer, i.data_);
     }
 
     friend std::ostream& operator<<(std::ostream& out, const Float& i) {
@@ -74,8 +89,9 @@ public:
         return out;
     }
 
-    friend std::istream& operator<<(std::istream& in, Float& i) {
+    friend std::istream& operator>>(std::istream& in, Float& i) {
         in >> i.data_;
+        i.Clean();
         return in;
     }
 
@@ -87,6 +103,12 @@ public:
     }
 
 private:
+    void Clean() {
+        if (std::abs(data_) < EPS) { // Gets rid of -0s
+            data_ = 0;
+        }
+    }
+
     const double EPS = 1e-6;
     double data_;
 };
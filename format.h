@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Text rendering of values into a caller-owned buffer. Types of the library
+// overload FormatTo(std::string&, const T&) next to their definition, found by
+// ADL, and print their parts by calling FormatTo on them in turn. Anything
+// else goes through its operator<<, which costs a stringstream per value
+template <typename T>
+void FormatTo(std::string& buffer, const T& value) {
+    std::ostringstream stream;
+    stream << value;
+    buffer += stream.view();
+}
+
+inline void FormatTo(std::string& buffer, long long value) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    buffer.append(digits, end);
+}
+
+// Same text as an ostream with default flags, i.e. printf's %g
+inline void FormatTo(std::string& buffer, double value) {
+    char digits[32];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6).ptr;
+    buffer.append(digits, end);
+}
+
+template <typename T>
+std::string Format(const T& value) {
+    std::string ans;
+    FormatTo(ans, value);
+    return ans;
+}
+
+enum class TableLayout {
+    Pretty,  // Columns right aligned inside big parentheses
+    Csv,
+    Tsv,
+};
+
+// Writes a rows x cols table whose cells are rendered by cell(buffer, i, j).
+// Each cell is rendered once, into one buffer for the whole table, and the
+// output goes to the stream in blocks of CHUNK bytes
+template <typename Cell>
+void WriteTable(std::ostream& stream, size_t rows, size_t cols, Cell cell, TableLayout layout = TableLayout::Pretty) {
+    static constexpr size_t CHUNK = 1 << 16;
+    std::string cells;
+    std::vector<size_t> ends(rows * cols);
+    std::vector<size_t> widths(cols);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            size_t start = cells.size();
+            cell(cells, i, j);
+            ends[i * cols + j] = cells.size();
+            widths[j] = std::max(widths[j], cells.size() - start);
+        }
+    }
+    std::string out;
+    out.reserve(CHUNK + 256);
+    auto flush = [&stream, &out](bool force) {
+        if (force || out.size() >= CHUNK) {
+            stream.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    };
+    size_t start = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        if (layout == TableLayout::Pretty) {
+            out += i == 0 ? "⎛ " : i + 1 == rows ? "⎝ " : "⎜ ";
+        }
+        for (size_t j = 0; j < cols; ++j) {
+            std::string_view text(cells.data() + start, ends[i * cols + j] - start);
+            start = ends[i * cols + j];
+            if (layout == TableLayout::Pretty) {
+                if (j) {
+                    out += ' ';
+                }
+                out.append(widths[j] - text.size(), ' ');
+                out += text;
+            } else if (layout == TableLayout::Tsv) {
+                if (j) {
+                    out += '\t';
+                }
+                out += text;
+            } else {
+                if (j) {
+                    out += ',';
+                }
+                if (text.find_first_of(",\"\n") == std::string_view::npos) {
+                    out += text;
+                    continue;
+                }
+                out += '"';
+                for (char c : text) {
+                    if (c == '"') {
+                        out += '"';
+                    }
+                    out += c;
+                }
+                out += '"';
+            }
+            flush(false);
+        }
+        if (layout == TableLayout::Pretty) {
+            out += i == 0 ? " ⎞\n" : i + 1 == rows ? " ⎠\n" : " ⎟\n";
+        } else {
+            out += '\n';
+        }
+        flush(false);
+    }
+    flush(true);
+}
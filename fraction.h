@@ -1,12 +1,15 @@
 #pragma once
 
+#include "format.h"
 #include "integer.h"
 #include "myconcepts.h"
 #include "poly.h"
+#include "poly_gcd.h"
 
 #include <compare>
 #include <iostream>
 #include <type_traits>
+#include <utility>
 
 template<EuclideanRing T>
 class Fraction {
@@ -47,17 +50,42 @@ public:
         return Fraction(-numerator_, denominator_);
     }
 
+    // In place, so that numerator and denominator reuse their storage when T
+    // allocates. Every right hand side is read before it can be overwritten,
+    // so a += a works
     Fraction& operator+=(const Fraction& other) {
-        return *this = *this + other;
+        T numerator = numerator_ * other.denominator_ + denominator_ * other.numerator_;
+        denominator_ *= other.denominator_;
+        numerator_ = std::move(numerator);
+        Shorten();
+        return *this;
     }
     Fraction& operator-=(const Fraction& other) {
-        return *this = *this - other;
+        T numerator = numerator_ * other.denominator_ - denominator_ * other.numerator_;
+        denominator_ *= other.denominator_;
+        numerator_ = std::move(numerator);
+        Shorten();
+        return *this;
     }
     Fraction& operator*=(const Fraction& other) {
-        return *this = *this * other;
+        numerator_ *= other.numerator_;
+        denominator_ *= other.denominator_;
+        Shorten();
+        return *this;
     }
     Fraction& operator/=(const Fraction& other) {
-        return *this = *this / other;
+        T numerator = numerator_ * other.denominator_;
+        denominator_ *= other.numerator_;
+        numerator_ = std::move(numerator);
+        Shorten();
+        return *this;
+    }
+
+    const T& GetNumerator() const {
+        return numerator_;
+    }
+    const T& GetDenominator() const {
+        return denominator_;
     }
 
     T GetIntegerPart() const {
@@ -67,6 +95,18 @@ public:
         return Fraction(numerator_ % denominator_, denominator_);
     }
 
+    friend void FormatTo(std::string& buffer, const Fraction& fraction) {
+        if (fraction.denominator_ == T::ONE()) {
+            FormatTo(buffer, fraction.numerator_);
+            return;
+        }
+        buffer += '(';
+        FormatTo(buffer, fraction.numerator_);
+        buffer += ")/(";
+        FormatTo(buffer, fraction.denominator_);
+        buffer += ')';
+    }
+
     friend std::ostream& operator<<(std::ostream& stream, const Fraction& fraction) {
         if (fraction.denominator_ == T::ONE()) {
             stream << fraction.numerator_;
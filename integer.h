@@ -3,6 +3,7 @@
 #include <compare>
 #include <iostream>
 
+#include "format.h"
 #include "mymath.h"
 
 class Integer {
@@ -16,6 +17,10 @@ public:
     Integer(int num): data_(num) {}
     Integer(long long num): data_(num) {}
 
+    explicit operator long long() const {
+        return data_;
+    }
+
     bool operator==(const Integer& other) const = default;
     bool operator!=(const Integer& other) const = default;
     std::strong_ordering operator<=>(const Integer& other) const = default;
@@ -39,19 +44,28 @@ public:
         return Integer(-data_);
     }
     Integer& operator+=(const Integer& other) {
-        return *this = *this + other;
+        data_ += other.data_;
+        return *this;
     }
     Integer& operator-=(const Integer& other) {
-        return *this = *this - other;
+        data_ -= other.data_;
+        return *this;
     }
     Integer& operator*=(const Integer& other) {
-        return *this = *this * other;
+        data_ *= other.data_;
+        return *this;
     }
     Integer& operator/=(const Integer& other) {
-        return *this = *this / other;
+        data_ /= other.data_;
+        return *this;
     }
     Integer& operator%=(const Integer& other) {
-        return *this = *this % other;
+        data_ %= other.data_;
+        return *this;
+    }
+
+    friend void FormatTo(std::string& buffer, const Integer& i) {
+        FormatTo(buffer, i.data_);
     }
 
     friend std::ostream& operator<<(std::ostream& out, const Integer& i) {
@@ -59,7 +73,7 @@ public:
         return out;
     }
 
-    friend std::istream& operator<<(std::istream& in, Integer& i) {
+    friend std::istream& operator>>(std::istream& in, Integer& i) {
         in >> i.data_;
         return in;
     }
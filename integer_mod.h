@@ -3,87 +3,122 @@
 #include <compare>
 #include <iostream>
 
+#include "exceptions.h"
+#include "format.h"
 #include "mymath.h"
 
-class IntegerMod {
+// Residues modulo a prime MOD, kept in (-MOD / 2, MOD / 2], so that every
+// residue has exactly one representative, MOD = 2 included
+template <long long MOD>
+class IntegerModulo {
 public:
-    IntegerMod() = default;
-    IntegerMod(const IntegerMod& other) = default;
-    IntegerMod(IntegerMod&& other) = default;
-    IntegerMod& operator=(const IntegerMod& other) = default;
-    IntegerMod& operator=(IntegerMod&& other) = default;
+    IntegerModulo() = default;
+    IntegerModulo(const IntegerModulo& other) = default;
+    IntegerModulo(IntegerModulo&& other) = default;
+    IntegerModulo& operator=(const IntegerModulo& other) = default;
+    IntegerModulo& operator=(IntegerModulo&& other) = default;
 
-    IntegerMod(int num): data_(num) {
+    IntegerModulo(int num): data_(num) {
         Normalize();
     }
 
-    IntegerMod(long long num): data_(num) {
+    IntegerModulo(long long num): data_(num) {
         Normalize();
     }
 
-    bool operator==(const IntegerMod& other) const = default;
-    bool operator!=(const IntegerMod& other) const = default;
-    std::strong_ordering operator<=>(const IntegerMod& other) const = default;
+    // The representative in (-MOD / 2, MOD / 2]
+    explicit operator long long() const {
+        return data_;
+    }
+
+    bool operator==(const IntegerModulo& other) const = default;
+    bool operator!=(const IntegerModulo& other) const = default;
+    std::strong_ordering operator<=>(const IntegerModulo& other) const = default;
 
-    IntegerMod operator+(const IntegerMod& other) const {
-        return IntegerMod(data_ + other.data_);
+    IntegerModulo operator+(const IntegerModulo& other) const {
+        return IntegerModulo(data_ + other.data_);
     }
-    IntegerMod operator-(const IntegerMod& other) const {
-        return IntegerMod(data_ - other.data_);
+    IntegerModulo operator-(const IntegerModulo& other) const {
+        return IntegerModulo(data_ - other.data_);
     }
-    IntegerMod operator*(const IntegerMod& other) const {
-        return IntegerMod(data_ * other.data_);
+    IntegerModulo operator*(const IntegerModulo& other) const {
+        return IntegerModulo(data_ * other.data_);
     }
-    IntegerMod operator/(const IntegerMod& other) const {
-        return *this * fastpow(other, MOD - 2);
+    IntegerModulo operator/(const IntegerModulo& other) const {
+        return *this * other.Inverse();
     }
-    IntegerMod operator-() const {
-        return IntegerMod(-data_);
+    IntegerModulo operator-() const {
+        return IntegerModulo(-data_);
     }
-    IntegerMod& operator+=(const IntegerMod& other) {
-        return *this = *this + other;
+    IntegerModulo& operator+=(const IntegerModulo& other) {
+        data_ += other.data_;
+        Normalize();
+        return *this;
     }
-    IntegerMod& operator-=(const IntegerMod& other) {
-        return *this = *this - other;
+    IntegerModulo& operator-=(const IntegerModulo& other) {
+        data_ -= other.data_;
+        Normalize();
+        return *this;
     }
-    IntegerMod& operator*=(const IntegerMod& other) {
-        return *this = *this * other;
+    IntegerModulo& operator*=(const IntegerModulo& other) {
+        data_ *= other.data_;
+        Normalize();
+        return *this;
+    }
+    IntegerModulo& operator/=(const IntegerModulo& other) {
+        return *this *= other.Inverse();
     }
-    IntegerMod& operator/=(const IntegerMod& other) {
-        return *this = *this / other;
+
+    friend void FormatTo(std::string& buffer, const IntegerModulo& i) {
+        FormatTo(buffer, i.data_);
     }
 
-    friend std::ostream& operator<<(std::ostream& out, const IntegerMod& i) {
+    friend std::ostream& operator<<(std::ostream& out, const IntegerModulo& i) {
         out << i.data_;
         return out;
     }
 
-    friend std::istream& operator<<(std::istream& in, IntegerMod& i) {
+    friend std::istream& operator>>(std::istream& in, IntegerModulo& i) {
         in >> i.data_;
+        i.Normalize();
         return in;
     }
 
-    static IntegerMod ONE() {
-        return IntegerMod(1);
+    static IntegerModulo ONE() {
+        return IntegerModulo(1);
     }
-    static IntegerMod ZERO() {
-        return IntegerMod(0);
+    static IntegerModulo ZERO() {
+        return IntegerModulo(0);
+    }
+
+    static long long Modulus() {
+        return MOD;
     }
 
 private:
-    static const long long MOD = 1e9 + 9;
     void Normalize() {
         data_ %= MOD;
-        while (data_ > MOD / 2) {
+        while (2 * data_ > MOD) {
             data_ -= MOD;
         }
-        while (data_ < -(MOD / 2)) {
+        while (2 * data_ <= -MOD) {
             data_ += MOD;
         }
     }
+
+    // By Fermat. Zero is checked explicitly, since 0^(MOD - 2) is 0 for odd
+    // MOD and 1 for MOD = 2
+    IntegerModulo Inverse() const {
+        if (data_ == 0) {
+            throw DivisionByZeroException();
+        }
+        return fastpow(*this, MOD - 2);
+    }
     long long data_;
 };
 
+using IntegerMod = IntegerModulo<1000000009>;
+
 inline IntegerMod operator "" _im(unsigned long long i) {
     return IntegerMod(static_cast<long long>(i));
 }
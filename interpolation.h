@@ -0,0 +1,124 @@
+#pragma once
+
+#include "integer.h"
+#include "integer_mod.h"
+#include "myconcepts.h"
+#include "poly.h"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename T>
+struct IsPolyType : std::false_type {};
+
+template <RingWithOne T>
+struct IsPolyType<Poly<T>> : std::true_type {
+    using Coefficient = T;
+};
+
+// Poly<T> with T a field, i.e. polynomials that can be interpolated
+template <typename T>
+concept PolyOverField = IsPolyType<T>::value && Field<typename IsPolyType<T>::Coefficient>;
+
+// 0, -1, 1, -2, 2, ..., count of them, kept small so that values at them
+// stay small too. Nothing if T doesn't have count such points: in
+// characteristic p the first p of them are distinct and the next one is the
+// same as the one before it
+template <Field T>
+std::optional<std::vector<T>> SamplePoints(size_t count) {
+    std::vector<T> ans;
+    ans.reserve(count);
+    T point = T::ZERO();
+    for (size_t i = 0; i < count; ++i) {
+        T next = i % 2 == 0 ? point : -point;
+        if (i != 0 && next == ans.back()) {
+            return std::nullopt;
+        }
+        ans.push_back(std::move(next));
+        if (i % 2 == 0) {
+            point += T::ONE();
+        }
+    }
+    return ans;
+}
+
+// The polynomial of degree below points.size() that takes values[i] at
+// points[i], by Newton's divided differences in O(n^2)
+template <Field T>
+Poly<T> Interpolate(const std::vector<T>& points, std::vector<T> values) {
+    size_t n = points.size();
+    for (size_t j = 1; j < n; ++j) {
+        for (size_t i = n - 1; i >= j; --i) {
+            values[i] = (values[i] - values[i - 1]) / (points[i] - points[i - j]);
+        }
+    }
+    // Horner on the Newton form: c0 + (x - x0)(c1 + (x - x1)(c2 + ...))
+    std::vector<T> ans(n, T::ZERO());
+    for (size_t k = n; k-- > 0;) {
+        for (size_t i = n - 1; i > 0; --i) {
+            ans[i] = ans[i - 1] - points[k] * ans[i];
+        }
+        ans[0] = values[k] - points[k] * ans[0];
+    }
+    return Poly<T>(ans);
+}
+
+// Primes below 2^30 whose product exceeds 2^65, so that three residues give
+// back any long long
+inline constexpr std::array<long long, 3> CRT_PRIMES = {1000000007, 1000000009, 998244353};
+
+// How many of CRT_PRIMES it takes to recover integers of absolute value up to
+// bound. Nothing from 2^63 on: that is past what Integer holds, and past what
+// the three primes are sure to tell apart
+inline std::optional<size_t> CrtPrimesFor(long double bound) {
+    if (bound >= 0x1p63L) {
+        return std::nullopt;
+    }
+    long double product = 1;
+    size_t ans = 0;
+    while (product <= 2 * bound) {
+        product *= static_cast<long double>(CRT_PRIMES[ans]);
+        ++ans;
+    }
+    return ans;
+}
+
+// Calls image(std::integral_constant<long long, CRT_PRIMES[i]>(), i) for the
+// first count primes, so that image can work in IntegerModulo of each of them
+template <typename Image>
+void ForCrtPrimes(size_t count, Image image) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        ((I < count ? image(std::integral_constant<long long, CRT_PRIMES[I]>(), I) : void()), ...);
+    }(std::make_index_sequence<CRT_PRIMES.size()>());
+}
+
+// The integer in (-M / 2, M / 2] with the given residues modulo the first
+// count of CRT_PRIMES, M being their product. Garner's algorithm
+inline Integer ChineseRemainder(const std::array<long long, CRT_PRIMES.size()>& residues, size_t count) {
+    auto power = [](long long a, long long n, long long mod) {
+        long long ans = 1;
+        for (; n > 0; n /= 2, a = a * a % mod) {
+            if (n % 2 == 1) {
+                ans = ans * a % mod;
+            }
+        }
+        return ans;
+    };
+    __int128 ans = 0;
+    __int128 product = 1;
+    for (size_t i = 0; i < count; ++i) {
+        long long mod = CRT_PRIMES[i];
+        long long difference = static_cast<long long>(((residues[i] - ans) % mod + mod) % mod);
+        long long inverse = power(static_cast<long long>(product % mod), mod - 2, mod);
+        ans += product * (difference * inverse % mod);
+        product *= mod;
+    }
+    if (ans > product / 2) {
+        ans -= product;
+    }
+    return Integer(static_cast<long long>(ans));
+}
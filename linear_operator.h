@@ -1,16 +1,25 @@
 #pragma once
 
+#include "echelon_space.h"
+#include "exceptions.h"
 #include "matrix.h"
+#include "mymath.h"
 #include "myconcepts.h"
 #include "poly.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "vector.h"
 #include "vector_space.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <exception>
 #include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
 #include <utility>
 #include <vector>
 
@@ -39,16 +48,22 @@ public:
         return LinearOperator(op.data_ * lambda);
     }
     LinearOperator& operator+=(const LinearOperator& other) {
-        return *this = *this + other;
+        data_ += other.data_;
+        ladders_.reset();
+        return *this;
     }
     LinearOperator& operator-=(const LinearOperator& other) {
-        return *this = *this - other;
+        data_ -= other.data_;
+        ladders_.reset();
+        return *this;
     }
     LinearOperator& operator*=(const LinearOperator& other) {
         return *this = *this * other;
     }
     LinearOperator& operator*=(const T& lambda) {
-        return *this = *this * lambda;
+        data_ *= lambda;
+        ladders_.reset();
+        return *this;
     }
     LinearOperator Power(size_t indicator) const {
         return LinearOperator(data_.Power(indicator));
@@ -86,18 +101,16 @@ public:
     }
 
     std::vector<std::pair<T, size_t>> GetJNFBlocks() const {
+        TRACE_SPAN("LinearOperator::GetJNFBlocks", data_.nsize(), data_.msize());
         std::vector<std::pair<T, size_t>> jordan_blocks;
-        auto solutions = data_.CharPoly().try_solve();
-        auto e = Matrix<T>::IdentityMatrix(data_.nsize());
-        for (auto [lambda, n_i] : solutions) {
-            size_t k = 1;
-            while (n_i > 0) {
-                size_t cnt_k = (data_ - lambda * e).Power(k + 1).rk() + (data_ - lambda * e).Power(k - 1).rk() - 2 * (data_ - lambda * e).Power(k).rk();
+        for (const auto& ladder : GetLadders()) {
+            size_t n_i = ladder.multiplicity;
+            for (size_t k = 1; n_i > 0 && k < ladder.ranks.size(); ++k) {
+                size_t cnt_k = ladder.Rank(k + 1) + ladder.Rank(k - 1) - 2 * ladder.Rank(k);
                 for (size_t i = 0; i < cnt_k; ++i) {
-                    jordan_blocks.emplace_back(lambda, k);
+                    jordan_blocks.emplace_back(ladder.lambda, k);
                 }
                 n_i -= cnt_k * k;
-                ++k;
             }
             assert(n_i == 0);
         }
@@ -120,55 +133,84 @@ public:
         return ans;
     }
 
+    // Generalized eigenspaces are independent, so chains for different
+    // eigenvalues are built in parallel and then merged in the usual order
     Matrix<T> GetJordanBasis() const {
-        auto jordan_blocks = GetJNFBlocks();
-        std::reverse(jordan_blocks.begin(), jordan_blocks.end());
-        size_t i = 0;
-        auto e = Matrix<T>::IdentityMatrix(data_.nsize());
+        TRACE_SPAN("LinearOperator::GetJordanBasis", data_.nsize(), data_.msize());
+        const auto& ladders = GetLadders();
+        std::vector<std::vector<Vector<T>>> parts(ladders.size());
+        std::atomic<size_t> done = 0;
+        ThreadPool::Global().ParallelFor(ladders.size(), [&](size_t i) {
+            parts[i] = GetJordanChains(ladders[ladders.size() - 1 - i]);
+            ReportProgress("LinearOperator::GetJordanBasis", ++done, ladders.size());
+        });
         std::vector<Vector<T>> basis;
-        while (i < jordan_blocks.size()) {
-            auto [lambda, n] = jordan_blocks[i];
-            std::vector<std::vector<Vector<T>>> chains;
-            std::vector<Vector<T>> current_vectors;
-            for (size_t j = n; j > 0; --j) {
-                for (auto& elem : current_vectors) {
-                    elem = (data_ - lambda * e) * elem;
-                }
-                size_t current_size = current_vectors.size();
-                auto kerj = LinearOperator<T>((data_ - lambda * e).Power(j)).ker();
-                auto kerjm1 = LinearOperator<T>((data_ - lambda * e).Power(j - 1)).ker();
-                std::vector<Vector<T>> to_filter;
-                for (const auto &elem : kerjm1.GetBasis()) {
-                    to_filter.push_back(elem);
-                }
-                for (const auto &elem : kerj.GetBasis()) {
-                    to_filter.push_back(elem);
-                }
-                auto filtered = VectorSpace<T>(to_filter).GetBasis();
-                for (size_t j2 = kerjm1.dim(); j2 < filtered.size(); ++j2) {
-                    current_vectors.push_back(filtered[j2]);
-                }
-                current_vectors = VectorSpace<T>(current_vectors).GetBasis();
-                for (ssize_t j2 = current_vectors.size() - 1; j2 >= static_cast<ssize_t>(current_size); --j2) {
-                    std::vector<Vector<T>> new_chain(j, Vector<T>(data_.nsize()));
-                    new_chain[0] = current_vectors[j2];
-                    for (size_t k = 1; k < j; ++k) {
-                        new_chain[k] = (data_ - lambda * e) * new_chain[k - 1];
-                    }
-                    // reverse(new_chain.begin(), new_chain.end());
-                    chains.push_back(new_chain);
-                }
+        for (const auto& part : parts) {
+            basis.insert(basis.end(), part.begin(), part.end());
+        }
+        std::reverse(basis.begin(), basis.end());
+        return VectorSpace(basis).GetBasisMatrix();
+    }
+
+    // Invariant factors d_1 | d_2 | ... | d_m, monic and nonconstant. The space is
+    // split into cyclic Krylov subspaces with invariant complements, and the
+    // minimal polynomials of the pieces are made into a divisibility chain with
+    // gcd / lcm. No eigenvalues are needed, so it works over any field
+    std::vector<Poly<T>> GetInvariantFactors() const {
+        std::vector<Poly<T>> factors;
+        std::mt19937 rng(data_.nsize());
+        Matrix<T> current = data_;
+        while (true) {
+            std::optional<CyclicSplit> split;
+            for (size_t attempt = 0; attempt < 64 && !split; ++attempt) {
+                split = SplitCyclic(current, rng);
+            }
+            if (!split) {
+                throw RandomizationFailedException();
+            }
+            factors.push_back(split->poly);
+            if (!split->rest) {
+                break;
+            }
+            current = std::move(*split->rest);
+        }
+        // F[x]/(f) + F[x]/(g) = F[x]/(lcm) + F[x]/(gcd), which works as max / min
+        // on every prime power at once, so this selection sort gives the chain
+        for (size_t i = 0; i < factors.size(); ++i) {
+            for (size_t j = i + 1; j < factors.size(); ++j) {
+                Poly<T> d = gcd(factors[i], factors[j]);
+                factors[i] = factors[i] * factors[j] / d;
+                factors[j] = d;
+            }
+        }
+        while (!factors.empty() && factors.back().deg() == 0) {
+            factors.pop_back();
+        }
+        std::reverse(factors.begin(), factors.end());
+        return factors;
+    }
+
+    // Rational canonical form: companion matrices of the invariant factors
+    Matrix<T> GetFrobeniusNF() const {
+        Matrix<T> ans(data_.size());
+        size_t offset = 0;
+        for (const auto& factor : GetInvariantFactors()) {
+            size_t k = factor.deg();
+            for (size_t i = 1; i < k; ++i) {
+                ans[offset + i][offset + i - 1] = T::ONE();
             }
-            // std::reverse(chains.begin(), chains.end());
-            for (const auto& chain : chains) {
-                for (const auto& vec : chain) {
-                    basis.push_back(vec);
+            for (const auto& [power, coefficient] : factor.GetCoefficients()) {
+                if (power < k) {
+                    ans[offset + power][offset + k - 1] = -coefficient;
                 }
             }
-            while (jordan_blocks.size() > i && lambda == jordan_blocks[i].first) {++i;}
+            offset += k;
         }
-        std::reverse(basis.begin(), basis.end());
-        return VectorSpace(basis).GetBasisMatrix();
+        return ans;
+    }
+
+    friend bool IsSimilar(const LinearOperator& a, const LinearOperator& b) {
+        return a.data_.size() == b.data_.size() && a.GetInvariantFactors() == b.GetInvariantFactors();
     }
 
     static LinearOperator ZERO(size_t n) {
@@ -179,5 +221,237 @@ public:
     }
 
 private:
+    struct CyclicSplit {
+        Poly<T> poly;
+        std::optional<Matrix<T>> rest;
+    };
+
+    // Takes a random v, W = span(v, Mv, ...) of dimension d, and a functional phi
+    // with phi(M^i v) = 0 for i < d - 1, phi(M^(d-1) v) = 1. Then
+    // U = {u : phi(M^i u) = 0, i < d} is a complement to W, and it's invariant
+    // whenever the minimal polynomial of v is the one of M, which is what a
+    // random v gets with high probability. Returns the minimal polynomial of v
+    // and M restricted to U, or nothing if U turned out not to be invariant
+    static std::optional<CyclicSplit> SplitCyclic(const Matrix<T>& m, std::mt19937& rng) {
+        size_t k = m.nsize();
+        std::uniform_int_distribution<int> distribution(-3, 3);
+        Vector<T> v(k);
+        for (size_t i = 0; i < k; ++i) {
+            v[i] = FromInteger<T>(distribution(rng));
+        }
+        std::vector<Vector<T>> krylov;
+        EchelonSpace<T> span(k);
+        while (span.Insert(v)) {
+            krylov.push_back(v);
+            v = Apply(m, v);
+        }
+        size_t d = krylov.size();
+        if (d == 0) {
+            return std::nullopt;
+        }
+        // M^d v = sum c_i M^i v
+        Matrix<T> dependency(k, d + 1);
+        for (size_t i = 0; i < k; ++i) {
+            for (size_t j = 0; j < d; ++j) {
+                dependency[i][j] = krylov[j][i];
+            }
+            dependency[i][d] = v[i];
+        }
+        dependency.Gauss();
+        std::vector<T> poly(d + 1, T::ZERO());
+        for (size_t i = 0; i < d; ++i) {
+            poly[i] = -dependency[i][d];
+        }
+        poly[d] = T::ONE();
+        CyclicSplit ans{Poly<T>(poly), std::nullopt};
+        if (d == k) {
+            return ans;
+        }
+        Matrix<T> transposed(d, k + 1);
+        for (size_t i = 0; i < d; ++i) {
+            for (size_t j = 0; j < k; ++j) {
+                transposed[i][j] = krylov[i][j];
+            }
+        }
+        transposed[d - 1][k] = T::ONE();
+        transposed.Gauss();
+        // psi_i = phi * M^i: rows 0..d-1 cut out U, and afterwards phi = psi_d must vanish on it
+        Matrix<T> psi(d, k);
+        Vector<T> phi(k);
+        for (size_t i = 0; i < k; ++i) {
+            phi[i] = T::ZERO();
+        }
+        size_t col = 0;
+        for (size_t i = 0; i < d; ++i) {
+            while (transposed[i][col] == T::ZERO()) {
+                ++col;
+            }
+            phi[col] = transposed[i][k];
+        }
+        for (size_t i = 0; i < d; ++i) {
+            for (size_t j = 0; j < k; ++j) {
+                psi[i][j] = phi[j];
+            }
+            Vector<T> next(k);
+            for (size_t j = 0; j < k; ++j) {
+                next[j] = T::ZERO();
+                for (size_t l = 0; l < k; ++l) {
+                    next[j] += phi[l] * m[l][j];
+                }
+            }
+            phi = std::move(next);
+        }
+        psi.Gauss();
+        std::vector<size_t> pivots;
+        std::vector<size_t> free;
+        for (size_t j = 0, row = 0; j < k; ++j) {
+            if (row < d && psi[row][j] != T::ZERO()) {
+                pivots.push_back(j);
+                ++row;
+            } else {
+                free.push_back(j);
+            }
+        }
+        std::vector<Vector<T>> complement;
+        for (size_t f : free) {
+            Vector<T> u(k);
+            for (size_t j = 0; j < k; ++j) {
+                u[j] = T::ZERO();
+            }
+            u[f] = T::ONE();
+            for (size_t r = 0; r < d; ++r) {
+                u[pivots[r]] = -psi[r][f];
+            }
+            T check = T::ZERO();
+            for (size_t j = 0; j < k; ++j) {
+                check += phi[j] * u[j];
+            }
+            if (check != T::ZERO()) {
+                return std::nullopt;
+            }
+            complement.push_back(std::move(u));
+        }
+        // Coordinates of a vector of U in this basis are its free coordinates
+        Matrix<T> rest(free.size(), free.size());
+        for (size_t c = 0; c < free.size(); ++c) {
+            Vector<T> image = Apply(m, complement[c]);
+            for (size_t r = 0; r < free.size(); ++r) {
+                rest[r][c] = image[free[r]];
+            }
+        }
+        ans.rest = std::move(rest);
+        return ans;
+    }
+
+    static Vector<T> Apply(const Matrix<T>& m, const Vector<T>& v) {
+        size_t k = m.nsize();
+        Vector<T> ans(k);
+        for (size_t i = 0; i < k; ++i) {
+            ans[i] = T::ZERO();
+            for (size_t j = 0; j < k; ++j) {
+                ans[i] += m[i][j] * v[j];
+            }
+        }
+        return ans;
+    }
+
+    // Everything Jordan form computations need for one eigenvalue: powers of
+    // N = A - lambda E with their ranks and kernels, up to the point where the
+    // rank stabilizes. Every power costs one multiplication and one Gauss
+    struct EigenvalueLadder {
+        T lambda;
+        size_t multiplicity;
+        std::vector<Matrix<T>> powers;
+        std::vector<size_t> ranks;
+        std::vector<VectorSpace<T>> kernels;
+
+        size_t Rank(size_t k) const {
+            return k < ranks.size() ? ranks[k] : ranks.back();
+        }
+        // Size of the biggest Jordan block
+        size_t Index() const {
+            return ranks.size() - 2;
+        }
+    };
+
+    // Jordan chains of one eigenvalue
+    std::vector<Vector<T>> GetJordanChains(const EigenvalueLadder& ladder) const {
+        std::vector<Vector<T>> basis;
+        const Matrix<T>& nilpotent = ladder.powers[1];
+        std::vector<std::vector<Vector<T>>> chains;
+        std::vector<Vector<T>> current_vectors;
+        for (size_t j = ladder.Index(); j > 0; --j) {
+            for (auto& elem : current_vectors) {
+                elem = nilpotent * elem;
+            }
+            size_t current_size = current_vectors.size();
+            const auto& kerj = ladder.kernels[j];
+            const auto& kerjm1 = ladder.kernels[j - 1];
+            std::vector<Vector<T>> to_filter;
+            for (const auto &elem : kerjm1.GetBasis()) {
+                to_filter.push_back(elem);
+            }
+            for (const auto &elem : kerj.GetBasis()) {
+                to_filter.push_back(elem);
+            }
+            auto filtered = VectorSpace<T>(to_filter).GetBasis();
+            for (size_t j2 = kerjm1.dim(); j2 < filtered.size(); ++j2) {
+                current_vectors.push_back(filtered[j2]);
+            }
+            current_vectors = VectorSpace<T>(current_vectors).GetBasis();
+            for (ssize_t j2 = current_vectors.size() - 1; j2 >= static_cast<ssize_t>(current_size); --j2) {
+                std::vector<Vector<T>> new_chain(j, Vector<T>(data_.nsize()));
+                new_chain[0] = current_vectors[j2];
+                for (size_t k = 1; k < j; ++k) {
+                    new_chain[k] = nilpotent * new_chain[k - 1];
+                }
+                // reverse(new_chain.begin(), new_chain.end());
+                chains.push_back(new_chain);
+            }
+        }
+        // std::reverse(chains.begin(), chains.end());
+        for (const auto& chain : chains) {
+            for (const auto& vec : chain) {
+                basis.push_back(vec);
+            }
+        }
+        return basis;
+    }
+
+    // Computed once and shared by GetJNF, GetJNFBlocks and GetJordanBasis
+    const std::vector<EigenvalueLadder>& GetLadders() const {
+        auto ladders = std::atomic_load(&ladders_);
+        if (ladders) {
+            return *ladders;
+        }
+        size_t n = data_.nsize();
+        auto e = Matrix<T>::IdentityMatrix(n);
+        auto solutions = data_.CharPoly().try_solve();
+        auto computed = std::make_shared<std::vector<EigenvalueLadder>>(solutions.size());
+        ThreadPool::Global().ParallelFor(solutions.size(), [&](size_t i) {
+            auto [lambda, n_i] = solutions[i];
+            EigenvalueLadder ladder{lambda, n_i, {e}, {n}, {VectorSpace<T>(e)}};
+            auto nilpotent = data_ - lambda * e;
+            do {
+                ladder.powers.push_back(ladder.powers.size() == 1 ? nilpotent : ladder.powers.back() * nilpotent);
+                ladder.kernels.emplace_back(ladder.powers.back());
+                ladder.ranks.push_back(n - ladder.kernels.back().dim());
+            } while (ladder.ranks.back() < ladder.ranks[ladder.ranks.size() - 2]);
+            (*computed)[i] = std::move(ladder);
+        });
+        std::shared_ptr<const std::vector<EigenvalueLadder>> expected;
+        std::atomic_compare_exchange_strong(&ladders_, &expected, std::shared_ptr<const std::vector<EigenvalueLadder>>(computed));
+        return *std::atomic_load(&ladders_);
+    }
+
     Matrix<T> data_;
+    mutable std::shared_ptr<const std::vector<EigenvalueLadder>> ladders_;
 };
+
+// Compares the exact invariant factors. Rational matrices get no shortcut
+// through residues modulo primes: reduction can both merge and split
+// similarity classes, so no fixed set of primes gives a sure answer
+template <Field T>
+bool IsSimilar(const Matrix<T>& a, const Matrix<T>& b) {
+    return IsSimilar(LinearOperator<T>(a), LinearOperator<T>(b));
+}
@@ -202,7 +202,35 @@ int solve5() {
     return 0;
 }
 
+// Determinants of polynomial matrices over fields with fewer elements than
+// the interpolation needs points, which must not give a wrong answer
+void check_small_fields() {
+    using Z2 = IntegerModulo<2>;
+    Poly<Z2> u({Z2(0), Z2(1)});
+    Matrix<Poly<Z2>> D = {
+        {u, Poly<Z2>()},
+        {Poly<Z2>(), u + Z2(1)}};
+    assert(Det(D) == u * u + u);
+    assert(D.CharPoly() == Poly<Poly<Z2>>({u, Poly<Z2>(Z2(1))}) * Poly<Poly<Z2>>({u + Z2(1), Poly<Z2>(Z2(1))}));
+    using Z3 = IntegerModulo<3>;
+    Poly<Z3> t({Z3(0), Z3(1)});
+    Matrix<Poly<Z3>> A = {
+        {t, Poly<Z3>(), Poly<Z3>()},
+        {Poly<Z3>(), t + Z3(1), Poly<Z3>()},
+        {Poly<Z3>(), Poly<Z3>(), t + Z3(2)}};
+    assert(Det(A) == Poly<Z3>({Z3(0), Z3(-1), Z3(0), Z3(1)}));
+    using Z5 = IntegerModulo<5>;
+    Poly<Z5> s({Z5(0), Z5(1)});
+    Matrix<Poly<Z5>> B = {
+        {s * s + s, Poly<Z5>()},
+        {Poly<Z5>(), s * s * s + Z5(2)}};
+    assert(Det(B) == (s * s + s) * (s * s * s + Z5(2)));
+    assert(B.CharPoly() == Poly<Poly<Z5>>({-(s * s + s), Poly<Z5>(Z5(1))}) *
+                           Poly<Poly<Z5>>({-(s * s * s + Z5(2)), Poly<Z5>(Z5(1))}));
+}
+
 int main() {
+    check_small_fields();
     solve1();
     cout << "--------------------------------------\n";
     solve2();
@@ -2,17 +2,32 @@
 
 #include "fraction.h"
 #include "exceptions.h"
+#include "execution_control.h"
+#include "format.h"
+#include "integer.h"
+#include "integer_mod.h"
+#include "interpolation.h"
 #include "permutation.h"
 #include "poly.h"
 #include "myconcepts.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <concepts>
 #include <cstddef>
 #include <initializer_list>
-#include <iomanip>
 #include <iostream>
+#include <map>
 #include <numeric>
-#include <sstream>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 template <RingWithOne T>
 class Matrix {
@@ -57,42 +72,93 @@ public:
     }
 
     Matrix operator+(const Matrix& other) const {
+        Matrix ans = *this;
+        ans += other;
+        return ans;
+    }
+
+    Matrix& operator+=(const Matrix& other) {
         if (other.size() != size()) {
             throw WrongSizeException();
         }
         size_t n = nsize();
         size_t m = msize();
-        Matrix ans(size());
         for (size_t i = 0; i < n; ++i) {
             for (size_t j = 0; j < m; ++j) {
-                ans[i][j] = data_[i][j] + other[i][j];
+                data_[i][j] += other[i][j];
             }
         }
-        return ans;
+        return *this;
     }
 
-    Matrix& operator+=(const Matrix& other) {
-        return *this = *this + other;
+    Matrix operator-() const {
+        return -Matrix(*this);
     }
 
-    Matrix operator-() const {
+    Matrix operator-(const Matrix& other) const {
         Matrix ans = *this;
+        ans -= other;
+        return ans;
+    }
+
+    Matrix& operator-=(const Matrix& other) {
+        if (other.size() != size()) {
+            throw WrongSizeException();
+        }
         size_t n = nsize();
         size_t m = msize();
         for (size_t i = 0; i < n; ++i) {
             for (size_t j = 0; j < m; ++j) {
-                ans[i][j] = -ans[i][j];
+                data_[i][j] -= other[i][j];
             }
         }
-        return ans;
+        return *this;
     }
 
-    Matrix operator-(const Matrix& other) const {
-        return *this + -other;
+    // Temporaries give their buffer to the result, so a chain like
+    // A - lambda * E allocates once
+    friend Matrix operator+(Matrix&& a, const Matrix& b) {
+        a += b;
+        return std::move(a);
     }
-
-    Matrix& operator-=(const Matrix& other) {
-        return *this = *this - other;
+    friend Matrix operator+(const Matrix& a, Matrix&& b) {
+        b += a;
+        return std::move(b);
+    }
+    friend Matrix operator+(Matrix&& a, Matrix&& b) {
+        a += b;
+        return std::move(a);
+    }
+    friend Matrix operator-(Matrix&& a, const Matrix& b) {
+        a -= b;
+        return std::move(a);
+    }
+    friend Matrix operator-(const Matrix& a, Matrix&& b) {
+        if (a.size() != b.size()) {
+            throw WrongSizeException();
+        }
+        for (size_t i = 0; i < b.nsize(); ++i) {
+            for (size_t j = 0; j < b.msize(); ++j) {
+                b[i][j] = a[i][j] - b[i][j];
+            }
+        }
+        return std::move(b);
+    }
+    friend Matrix operator-(Matrix&& a, Matrix&& b) {
+        a -= b;
+        return std::move(a);
+    }
+    friend Matrix operator-(Matrix&& a) {
+        for (auto& row : a.data_) {
+            for (auto& elem : row) {
+                elem = -elem;
+            }
+        }
+        return std::move(a);
+    }
+    friend Matrix operator*(Matrix&& a, const T& lambda) {
+        a *= lambda;
+        return std::move(a);
     }
 
     Matrix<T> operator*(const Matrix<T>& other) const {
@@ -164,10 +230,12 @@ public:
     }
 
     void Gauss() {
+        TRACE_SPAN("Matrix::Gauss", nsize(), msize());
         size_t n = nsize();
         size_t m = msize();
         size_t start = 0;
         for (size_t j = 0; j < m; ++j) {
+            ReportProgress("Matrix::Gauss", j, m);
             size_t with_non_zero_coefficient = 0;
             bool found = false;
             for (size_t i = start; i < n; ++i) {
@@ -192,6 +260,7 @@ public:
                 if (data_[i][j] == T::ZERO()) {
                     continue;
                 }
+                CheckExecution();
                 auto lambda = -data_[i][j];
                 for (size_t k = j; k < m; ++k) {
                     data_[i][k] += lambda * data_[start][k];
@@ -199,6 +268,7 @@ public:
             }
             ++start;
         }
+        ReportProgress("Matrix::Gauss", m, m);
     }
 
     Matrix Transpose() const {
@@ -240,6 +310,7 @@ public:
     }
 
     Matrix Power(size_t indicator) const {
+        TRACE_SPAN("Matrix::Power", nsize(), msize());
         if (nsize() != msize()) {
             throw WrongSizeException();
         }
@@ -251,6 +322,7 @@ public:
     }
 
     Matrix Inverse() const {
+        TRACE_SPAN("Matrix::Inverse", nsize(), msize());
         size_t n = nsize();
         size_t m = msize();
         if (n != m) {
@@ -265,29 +337,48 @@ public:
     }
 
     Poly<T> CharPoly() const requires(Field<T>) {
+        TRACE_SPAN("Matrix::CharPoly", nsize(), msize());
         size_t n = nsize();
         size_t m = msize();
         if (n != m) {
             throw WrongSizeException();
         }
-        Matrix<Fraction<Poly<T>>> ch(n, n);
-        for (size_t i = 0; i < n; ++i) {
-            for (size_t j = 0; j < n; ++j) {
-                ch[i][j] -= Poly<T>((*this)[i][j]);
+        // The elimination churns through short-lived polynomials, so all of
+        // them live in an arena and only the answer is moved out to the heap
+        Poly<T> ans;
+        {
+            PolyArena arena;
+            Matrix<Fraction<Poly<T>>> ch(n, n);
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    ch[i][j] -= Poly<T>((*this)[i][j]);
+                }
             }
+            for (size_t i = 0; i < n; ++i) {
+                ch[i][i] += Poly<T>({T::ZERO(), T::ONE()});
+            }
+            ans = Det(std::move(ch)).GetIntegerPart();
         }
-        for (size_t i = 0; i < n; ++i) {
-            ch[i][i] += Poly<T>({T::ZERO(), T::ONE()});
-        }
-        return Det(ch).GetIntegerPart();
+        return ans;
     }
 
     Poly<T> CharPoly() const requires(!Field<T>) {
+        TRACE_SPAN("Matrix::CharPoly", nsize(), msize());
         size_t n = nsize();
         size_t m = msize();
         if (n != m) {
             throw WrongSizeException();
         }
+        // Polynomial entries: interpolated where possible, see InterpolatedDet
+        if constexpr (std::same_as<T, Poly<Integer>> || std::same_as<T, Poly<Fraction<Integer>>>) {
+            if (auto ans = ModularCharPoly(*this)) {
+                return *ans;
+            }
+        } else if constexpr (PolyOverField<T>) {
+            if (auto ans = InterpolatedCharPoly(*this)) {
+                return *ans;
+            }
+        }
         Matrix<Poly<T>> ch(n, n);
         for (size_t i = 0; i < n; ++i) {
             for (size_t j = 0; j < n; ++j) {
@@ -341,52 +432,29 @@ Matrix<T> operator*(const T& lambda, const Matrix<T>& matrix) {
     return matrix * lambda;
 }
 
+template <RingWithOne T>
+Matrix<T> operator*(const T& lambda, Matrix<T>&& matrix) {
+    return std::move(matrix) * lambda;
+}
+
+template <RingWithOne T>
+void WriteTable(std::ostream& stream, const Matrix<T>& matrix, TableLayout layout) {
+    size_t n = matrix.nsize();
+    WriteTable(stream, n, n ? matrix.msize() : 0, [&matrix](std::string& buffer, size_t i, size_t j) {
+        FormatTo(buffer, matrix[i][j]);
+    }, layout);
+}
+
 template <RingWithOne T>
 std::ostream& operator<<(std::ostream& stream, const Matrix<T>& matrix) {
-    std::vector<size_t> maxsizes(matrix.msize());
-    for (size_t i = 0; i < matrix.nsize(); ++i) {
-        for (size_t j = 0; j < matrix.msize(); ++j) {
-            std::stringstream tmp;
-            tmp << matrix[i][j];
-            maxsizes[j] = std::max(maxsizes[j], tmp.str().size());
-            // stream << streams[i][j].str() << ' ';
-            // stream << matrix[i][j] << ' ';
-        }
-        // stream << '\n';
-    }
-    for (size_t i = 0; i < matrix.nsize(); ++i) {
-        if (i == 0) {
-            stream << "⎛ ";
-            // stream << "⎡ ";
-        } else if (i == matrix.nsize() - 1) {
-            stream << "⎝ ";
-            // stream << "⎣ ";
-        } else {
-            stream << "⎜ ";
-            // stream << "⎢ ";
-        }
-        for (size_t j = 0; j < matrix.msize(); ++j) {
-            std::stringstream tmp;
-            tmp << matrix[i][j];
-            stream << (j ? " " : "") << std::setw(static_cast<int>(maxsizes[j])) << tmp.str();
-        }
-        if (i == 0) {
-            stream << " ⎞\n";
-            // stream << " ⎤\n";
-        } else if (i == matrix.nsize() - 1) {
-            stream << " ⎠\n";
-            // stream << " ⎦\n";
-        } else {
-            stream << " ⎟\n";
-            // stream << " ⎥\n";
-        }
-    }
+    WriteTable(stream, matrix, TableLayout::Pretty);
     return stream;
 }
 
 template <RingWithOne T>
     requires Field<T>
 T Det(Matrix<T> matrix) {
+    TRACE_SPAN("Det", matrix.nsize(), matrix.msize());
     size_t n = matrix.nsize();
     size_t m = matrix.msize();
     if (n != m) {
@@ -395,6 +463,7 @@ T Det(Matrix<T> matrix) {
     size_t start = 0;
     T ans = T::ONE();
     for (size_t j = 0; j < n; ++j) {
+        ReportProgress("Det", j, n);
         size_t with_non_zero_coefficient = 0;
         bool found = false;
         for (size_t i = start; i < n; ++i) {
@@ -423,6 +492,7 @@ T Det(Matrix<T> matrix) {
             if (matrix[i][j] == T::ZERO()) {
                 continue;
             }
+            CheckExecution();
             auto lambda = -matrix[i][j];
             for (size_t k = j; k < n; ++k) {
                 matrix[i][k] += lambda * matrix[start][k];
@@ -430,33 +500,363 @@ T Det(Matrix<T> matrix) {
         }
         ++start;
     }
+    ReportProgress("Det", n, n);
     for (size_t i = 0; i < n; ++i) {
         ans *= matrix[i][i];
     }
     return ans;
 }
 
+// Determinants of polynomial matrices by evaluation and interpolation. The
+// degree of det A is at most the sum over rows (or over columns) of the
+// largest degree in each, so det A is known from its values at that many
+// points plus one. Those are scalar determinants, taken in parallel, which
+// replaces n! products of polynomials with O(n^3 d) scalar operations
+
+template <RingWithOne T>
+size_t DetDegreeBound(const Matrix<Poly<T>>& matrix) {
+    size_t n = matrix.nsize();
+    size_t by_rows = 0;
+    std::vector<size_t> columns(n);
+    for (size_t i = 0; i < n; ++i) {
+        size_t row = 0;
+        for (size_t j = 0; j < n; ++j) {
+            row = std::max(row, matrix[i][j].deg());
+            columns[j] = std::max(columns[j], matrix[i][j].deg());
+        }
+        by_rows += row;
+    }
+    return std::min(by_rows, std::accumulate(columns.begin(), columns.end(), size_t(0)));
+}
+
+template <RingWithOne T>
+Matrix<T> EvaluateAt(const Matrix<Poly<T>>& matrix, const T& x) {
+    size_t n = matrix.nsize();
+    size_t m = matrix.msize();
+    Matrix<T> ans(n, m);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+            ans[i][j] = matrix[i][j](x);
+        }
+    }
+    return ans;
+}
+
+// Nothing if T has too few elements to interpolate at
+template <Field T>
+std::optional<Poly<T>> InterpolatedDet(const Matrix<Poly<T>>& matrix) {
+    TRACE_SPAN("InterpolatedDet", matrix.nsize(), matrix.msize());
+    if (matrix.nsize() != matrix.msize()) {
+        throw WrongSizeException();
+    }
+    std::optional<std::vector<T>> points = SamplePoints<T>(DetDegreeBound(matrix) + 1);
+    if (!points) {
+        return std::nullopt;
+    }
+    std::vector<T> values(points->size(), T::ZERO());
+    ThreadPool::Global().ParallelFor(points->size(), [&](size_t k) {
+        values[k] = Det(EvaluateAt(matrix, (*points)[k]));
+    });
+    return Interpolate(*points, std::move(values));
+}
+
+// det(xD - A) with A depending on t and D = diag(diagonal) constant, as a
+// polynomial in x with coefficients in t. x on the diagonal has degree 0 in
+// t, so the degree bound of det A holds for every coefficient. The values are
+// scalar determinants on a grid of points for t and for x, interpolated
+// first along x and then along t. Nothing if T has too few elements for that
+template <Field T>
+std::optional<Poly<Poly<T>>> InterpolatedCharPoly(const Matrix<Poly<T>>& matrix, const std::vector<T>& diagonal) {
+    TRACE_SPAN("InterpolatedCharPoly", matrix.nsize(), matrix.msize());
+    size_t n = matrix.nsize();
+    if (n != matrix.msize() || diagonal.size() != n) {
+        throw WrongSizeException();
+    }
+    std::optional<std::vector<T>> t_points = SamplePoints<T>(DetDegreeBound(matrix) + 1);
+    std::optional<std::vector<T>> x_points = SamplePoints<T>(n + 1);
+    if (!t_points || !x_points) {
+        return std::nullopt;
+    }
+    size_t width = x_points->size();
+    std::vector<T> values(t_points->size() * width, T::ZERO());
+    ThreadPool::Global().ParallelFor(values.size(), [&](size_t k) {
+        const T& x = (*x_points)[k % width];
+        Matrix<T> shifted = -EvaluateAt(matrix, (*t_points)[k / width]);
+        for (size_t i = 0; i < n; ++i) {
+            shifted[i][i] += diagonal[i] * x;
+        }
+        values[k] = Det(std::move(shifted));
+    });
+    std::vector<std::vector<T>> by_power(n + 1, std::vector<T>(t_points->size(), T::ZERO()));
+    for (size_t k = 0; k < t_points->size(); ++k) {
+        auto begin = values.begin() + static_cast<ptrdiff_t>(k * width);
+        Poly<T> at_t = Interpolate(*x_points, std::vector<T>(begin, begin + static_cast<ptrdiff_t>(width)));
+        for (const auto& [power, coefficient] : at_t.GetCoefficients()) {
+            by_power[power][k] = coefficient;
+        }
+    }
+    std::vector<Poly<T>> ans;
+    ans.reserve(n + 1);
+    for (auto& column : by_power) {
+        ans.push_back(Interpolate(*t_points, std::move(column)));
+    }
+    return Poly<Poly<T>>(ans);
+}
+
+// det(xI - A), like Matrix<Poly<T>>::CharPoly
+template <Field T>
+std::optional<Poly<Poly<T>>> InterpolatedCharPoly(const Matrix<Poly<T>>& matrix) {
+    return InterpolatedCharPoly(matrix, std::vector<T>(matrix.nsize(), T::ONE()));
+}
+
+// Integer coefficients go through IntegerModulo of as many CRT_PRIMES as the
+// size of the answer needs: every coefficient of det A is at most the product
+// over rows of the sums of absolute values of the coefficients in the row.
+// Rational ones are brought to integers first, a row at a time, so that no
+// fraction grows along the way. Answers that may not fit in long long give
+// nothing, and are left to the exact expansion
+
+template <long long MOD>
+Matrix<Poly<IntegerModulo<MOD>>> ReduceModulo(const Matrix<Poly<Integer>>& matrix) {
+    size_t n = matrix.nsize();
+    size_t m = matrix.msize();
+    Matrix<Poly<IntegerModulo<MOD>>> ans(n, m);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+            for (const auto& [power, coefficient] : matrix[i][j].GetCoefficients()) {
+                ans[i][j] += Poly<IntegerModulo<MOD>>(IntegerModulo<MOD>(static_cast<long long>(coefficient)), power);
+            }
+        }
+    }
+    return ans;
+}
+
+// Bound for det(xD - A) with D = diag(diagonal): |D_ii| is added to the sum
+// of row i. An empty diagonal stands for zero, i.e. det A
+inline long double CoefficientBound(const Matrix<Poly<Integer>>& matrix, const std::vector<Integer>& diagonal) {
+    long double ans = 1;
+    for (size_t i = 0; i < matrix.nsize(); ++i) {
+        long double row = diagonal.empty() ? 0 : std::abs(static_cast<long double>(static_cast<long long>(diagonal[i])));
+        for (size_t j = 0; j < matrix.msize(); ++j) {
+            for (const auto& [power, coefficient] : matrix[i][j].GetCoefficients()) {
+                row += std::abs(static_cast<long double>(static_cast<long long>(coefficient)));
+            }
+        }
+        ans *= row;
+    }
+    return ans;
+}
+
+// a * b, or nothing if it leaves long long
+inline std::optional<Integer> CheckedProduct(const Integer& a, const Integer& b) {
+    long long ans;
+    if (__builtin_mul_overflow(static_cast<long long>(a), static_cast<long long>(b), &ans)) {
+        return std::nullopt;
+    }
+    return Integer(ans);
+}
+
+// (L, DA) with L_i the least common denominator of row i and D = diag(L).
+// Nothing if some L_i or coefficient of DA leaves long long
+inline std::optional<std::pair<std::vector<Integer>, Matrix<Poly<Integer>>>> ClearDenominators(
+    const Matrix<Poly<Fraction<Integer>>>& matrix) {
+    size_t n = matrix.nsize();
+    size_t m = matrix.msize();
+    std::vector<Integer> scales(n, Integer::ONE());
+    Matrix<Poly<Integer>> ans(n, m);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+            for (const auto& [power, coefficient] : matrix[i][j].GetCoefficients()) {
+                Integer denominator = abs(coefficient.GetDenominator());
+                auto scale = CheckedProduct(scales[i] / abs(gcd(scales[i], denominator)), denominator);
+                if (!scale) {
+                    return std::nullopt;
+                }
+                scales[i] = *scale;
+            }
+        }
+        for (size_t j = 0; j < m; ++j) {
+            for (const auto& [power, coefficient] : matrix[i][j].GetCoefficients()) {
+                auto value = CheckedProduct(coefficient.GetNumerator(), scales[i] / coefficient.GetDenominator());
+                if (!value) {
+                    return std::nullopt;
+                }
+                ans[i][j] += Poly<Integer>(*value, power);
+            }
+        }
+    }
+    return std::make_pair(std::move(scales), std::move(ans));
+}
+
+// value / (scales[0] * scales[1] * ...), reduced after every factor, so that
+// it only overflows if the answer itself does. In which case nothing
+inline std::optional<Fraction<Integer>> Unscale(const Integer& value, const std::vector<Integer>& scales) {
+    Integer numerator = value;
+    Integer denominator = Integer::ONE();
+    for (const auto& scale : scales) {
+        Integer common = abs(gcd(numerator, scale));
+        numerator /= common;
+        auto product = CheckedProduct(denominator, scale / common);
+        if (!product) {
+            return std::nullopt;
+        }
+        denominator = *product;
+    }
+    return Fraction<Integer>(numerator, denominator);
+}
+
+inline std::optional<Poly<Integer>> ModularDet(const Matrix<Poly<Integer>>& matrix) {
+    TRACE_SPAN("ModularDet", matrix.nsize(), matrix.msize());
+    if (matrix.nsize() != matrix.msize()) {
+        throw WrongSizeException();
+    }
+    std::optional<size_t> primes = CrtPrimesFor(CoefficientBound(matrix, {}));
+    if (!primes) {
+        return std::nullopt;
+    }
+    std::map<size_t, std::array<long long, CRT_PRIMES.size()>> residues;
+    ForCrtPrimes(*primes, [&]<long long MOD>(std::integral_constant<long long, MOD>, size_t index) {
+        // CRT_PRIMES are far above any degree bound, so there are always enough points
+        Poly<IntegerModulo<MOD>> image = *InterpolatedDet(ReduceModulo<MOD>(matrix));
+        for (const auto& [power, coefficient] : image.GetCoefficients()) {
+            residues[power][index] = static_cast<long long>(coefficient);
+        }
+    });
+    Poly<Integer> ans;
+    for (const auto& [power, values] : residues) {
+        ans += Poly<Integer>(ChineseRemainder(values, *primes), power);
+    }
+    return ans;
+}
+
+// det A = det(DA) / (L_1 ... L_n)
+inline std::optional<Poly<Fraction<Integer>>> ModularDet(const Matrix<Poly<Fraction<Integer>>>& matrix) {
+    auto cleared = ClearDenominators(matrix);
+    if (!cleared) {
+        return std::nullopt;
+    }
+    const auto& [scales, integral] = *cleared;
+    std::optional<Poly<Integer>> det = ModularDet(integral);
+    if (!det) {
+        return std::nullopt;
+    }
+    Poly<Fraction<Integer>> ans;
+    for (const auto& [power, coefficient] : det->GetCoefficients()) {
+        auto value = Unscale(coefficient, scales);
+        if (!value) {
+            return std::nullopt;
+        }
+        ans += Poly<Fraction<Integer>>(*value, power);
+    }
+    return ans;
+}
+
+// det(xD - A) with D = diag(diagonal)
+inline std::optional<Poly<Poly<Integer>>> ModularCharPoly(const Matrix<Poly<Integer>>& matrix,
+                                                          const std::vector<Integer>& diagonal) {
+    TRACE_SPAN("ModularCharPoly", matrix.nsize(), matrix.msize());
+    if (matrix.nsize() != matrix.msize() || diagonal.size() != matrix.nsize()) {
+        throw WrongSizeException();
+    }
+    std::optional<size_t> primes = CrtPrimesFor(CoefficientBound(matrix, diagonal));
+    if (!primes) {
+        return std::nullopt;
+    }
+    std::map<std::pair<size_t, size_t>, std::array<long long, CRT_PRIMES.size()>> residues;
+    ForCrtPrimes(*primes, [&]<long long MOD>(std::integral_constant<long long, MOD>, size_t index) {
+        std::vector<IntegerModulo<MOD>> reduced;
+        for (const auto& entry : diagonal) {
+            reduced.emplace_back(static_cast<long long>(entry));
+        }
+        Poly<Poly<IntegerModulo<MOD>>> image = *InterpolatedCharPoly(ReduceModulo<MOD>(matrix), reduced);
+        for (const auto& [power, coefficient] : image.GetCoefficients()) {
+            for (const auto& [inner, value] : coefficient.GetCoefficients()) {
+                residues[{power, inner}][index] = static_cast<long long>(value);
+            }
+        }
+    });
+    std::vector<Poly<Integer>> ans(matrix.nsize() + 1);
+    for (const auto& [powers, values] : residues) {
+        ans[powers.first] += Poly<Integer>(ChineseRemainder(values, *primes), powers.second);
+    }
+    return Poly<Poly<Integer>>(ans);
+}
+
+inline std::optional<Poly<Poly<Integer>>> ModularCharPoly(const Matrix<Poly<Integer>>& matrix) {
+    return ModularCharPoly(matrix, std::vector<Integer>(matrix.nsize(), Integer::ONE()));
+}
+
+// det(xI - A) = det(xD - DA) / (L_1 ... L_n)
+inline std::optional<Poly<Poly<Fraction<Integer>>>> ModularCharPoly(const Matrix<Poly<Fraction<Integer>>>& matrix) {
+    auto cleared = ClearDenominators(matrix);
+    if (!cleared) {
+        return std::nullopt;
+    }
+    const auto& [scales, integral] = *cleared;
+    std::optional<Poly<Poly<Integer>>> char_poly = ModularCharPoly(integral, scales);
+    if (!char_poly) {
+        return std::nullopt;
+    }
+    std::vector<Poly<Fraction<Integer>>> ans(matrix.nsize() + 1);
+    for (const auto& [power, coefficient] : char_poly->GetCoefficients()) {
+        for (const auto& [inner, value] : coefficient.GetCoefficients()) {
+            auto unscaled = Unscale(value, scales);
+            if (!unscaled) {
+                return std::nullopt;
+            }
+            ans[power] += Poly<Fraction<Integer>>(*unscaled, inner);
+        }
+    }
+    return Poly<Poly<Fraction<Integer>>>(ans);
+}
+
 template <RingWithOne T>
     requires(!Field<T>)
 T Det(Matrix<T> matrix) {
+    TRACE_SPAN("Det", matrix.nsize(), matrix.msize());
     size_t n = matrix.nsize();
     size_t m = matrix.msize();
     if (n != m) {
         throw WrongSizeException();
     }
-    T ans = T::ZERO();
-    for (const auto& indexes : AllPermutations(n)) {
+    // Polynomial entries are interpolated where that is possible, see
+    // InterpolatedDet, and otherwise expanded like everything else
+    if constexpr (std::same_as<T, Poly<Integer>> || std::same_as<T, Poly<Fraction<Integer>>>) {
+        if (auto ans = ModularDet(matrix)) {
+            return *ans;
+        }
+    } else if constexpr (PolyOverField<T>) {
+        if (auto ans = InterpolatedDet(matrix)) {
+            return *ans;
+        }
+    }
+    const Matrix<T>& a = matrix;
+    // Progress counts permutations, and is only kept when someone listens
+    const ExecutionControl* control = ExecutionControl::Current();
+    size_t total = 1;
+    for (size_t i = 2; i <= n; ++i) {
+        total *= i;
+    }
+    std::atomic<size_t> done = 0;
+    return PermutationEngine(n).Reduce(T::ZERO(), [&a, n, control, total, &done](T& ans, const Permutation& indexes, int sign) {
+        if (control) {
+            size_t count = done.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (count % 1024 == 0 || count == total) {
+                control->Report("Det", count, total);
+            }
+        }
         T cur = T::ONE();
         for (size_t i = 0; i < n; ++i) {
-            cur *= matrix[i][indexes[i]];
+            cur *= a[i][indexes[i]];
         }
-        if (indexes.sign() == -1) {
+        if (sign == -1) {
             ans -= cur;
         } else {
             ans += cur;
         }
-    }
-    return ans;
+    }, [](T& ans, const T& other) {
+        ans += other;
+    });
 }
 
 template <RingWithOne T, RingWithOne P>
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "exceptions.h"
+#include "matrix.h"
+#include "myconcepts.h"
+#include "poly.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// count matrices of the same shape, stored interleaved: entry (i, j) of all of
+// them is one contiguous run of count elements. Every kernel does the same
+// operation on a whole run, so the innermost loop goes over the batch, which
+// vectorizes, and the batch is split into chunks between threads. One
+// allocation for the whole batch instead of one per row of every matrix
+template <RingWithOne T>
+class MatrixBatch {
+public:
+    MatrixBatch(size_t count, size_t n, size_t m) : count_(count), n_(n), m_(m), data_(count * n * m, T::ZERO()) {}
+
+    MatrixBatch(const std::vector<Matrix<T>>& matrices)
+        : MatrixBatch(matrices.size(), matrices.empty() ? 0 : matrices[0].nsize(),
+                      matrices.empty() ? 0 : matrices[0].msize()) {
+        for (size_t b = 0; b < count_; ++b) {
+            Set(b, matrices[b]);
+        }
+    }
+
+    size_t count() const {
+        return count_;
+    }
+    size_t nsize() const {
+        return n_;
+    }
+    size_t msize() const {
+        return m_;
+    }
+
+    T& operator()(size_t b, size_t i, size_t j) {
+        return data_[Index(i, j) + b];
+    }
+    const T& operator()(size_t b, size_t i, size_t j) const {
+        return data_[Index(i, j) + b];
+    }
+
+    Matrix<T> Get(size_t b) const {
+        Matrix<T> ans(n_, m_);
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t j = 0; j < m_; ++j) {
+                ans[i][j] = (*this)(b, i, j);
+            }
+        }
+        return ans;
+    }
+
+    void Set(size_t b, const Matrix<T>& matrix) {
+        if (matrix.nsize() != n_ || matrix.msize() != m_) {
+            throw WrongSizeException();
+        }
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t j = 0; j < m_; ++j) {
+                (*this)(b, i, j) = matrix[i][j];
+            }
+        }
+    }
+
+    // Pairwise products
+    MatrixBatch operator*(const MatrixBatch& other) const {
+        if (count_ != other.count_ || m_ != other.n_) {
+            throw WrongSizeException();
+        }
+        MatrixBatch ans(count_, n_, other.m_);
+        ForChunks([&](size_t begin, size_t end) {
+            for (size_t i = 0; i < n_; ++i) {
+                for (size_t l = 0; l < m_; ++l) {
+                    const T* a = &data_[Index(i, l)];
+                    for (size_t j = 0; j < other.m_; ++j) {
+                        const T* b = &other.data_[other.Index(l, j)];
+                        T* c = &ans.data_[ans.Index(i, j)];
+                        for (size_t k = begin; k < end; ++k) {
+                            c[k] += a[k] * b[k];
+                        }
+                    }
+                }
+            }
+        });
+        return ans;
+    }
+
+    // Elimination with a pivot chosen per matrix over a field, Berkowitz otherwise
+    friend std::vector<T> Det(const MatrixBatch& batch) {
+        if (batch.n_ != batch.m_) {
+            throw WrongSizeException();
+        }
+        std::vector<T> ans(batch.count_, T::ONE());
+        if constexpr (Field<T>) {
+            batch.ForChunks([&](size_t begin, size_t end) {
+                Workspace work = batch.Load(begin, end, nullptr);
+                work.Eliminate(false);
+                std::copy(work.det.begin(), work.det.end(), ans.begin() + begin);
+            });
+        } else {
+            batch.ForChunks([&](size_t begin, size_t end) {
+                std::vector<T> poly = batch.Berkowitz(begin, end);
+                for (size_t k = begin; k < end; ++k) {
+                    ans[k] = (batch.n_ % 2 == 0 ? poly[k - begin] : -poly[k - begin]);
+                }
+            });
+        }
+        return ans;
+    }
+
+    // Throws SingularMatrixException if any of the matrices is singular
+    MatrixBatch Inverse() const requires Field<T> {
+        if (n_ != m_) {
+            throw WrongSizeException();
+        }
+        MatrixBatch identity(count_, n_, n_);
+        for (size_t i = 0; i < n_; ++i) {
+            std::fill_n(&identity.data_[identity.Index(i, i)], count_, T::ONE());
+        }
+        return Solve(identity);
+    }
+
+    // X with A X = B for every pair A, B
+    MatrixBatch Solve(const MatrixBatch& rhs) const requires Field<T> {
+        if (n_ != m_ || rhs.count_ != count_ || rhs.n_ != n_) {
+            throw WrongSizeException();
+        }
+        MatrixBatch ans(count_, n_, rhs.m_);
+        ForChunks([&](size_t begin, size_t end) {
+            Workspace work = Load(begin, end, &rhs);
+            work.Eliminate(true);
+            for (const auto& det : work.det) {
+                if (det == T::ZERO()) {
+                    throw SingularMatrixException();
+                }
+            }
+            for (size_t i = 0; i < n_; ++i) {
+                for (size_t j = 0; j < rhs.m_; ++j) {
+                    std::copy_n(&work.At(i, n_ + j, 0), end - begin, &ans.data_[ans.Index(i, j) + begin]);
+                }
+            }
+        });
+        return ans;
+    }
+
+    // det(xI - A) of every matrix, division free so it works over any ring
+    std::vector<Poly<T>> CharPoly() const {
+        if (n_ != m_) {
+            throw WrongSizeException();
+        }
+        std::vector<Poly<T>> ans(count_);
+        ForChunks([&](size_t begin, size_t end) {
+            size_t lanes = end - begin;
+            std::vector<T> poly = Berkowitz(begin, end);
+            for (size_t k = 0; k < lanes; ++k) {
+                std::vector<T> coefficients(n_ + 1);
+                for (size_t t = 0; t <= n_; ++t) {
+                    coefficients[t] = poly[t * lanes + k];
+                }
+                ans[begin + k] = Poly<T>(coefficients);
+            }
+        });
+        return ans;
+    }
+
+private:
+    static constexpr size_t LANES_PER_TASK = 64;
+
+    // Rows of (A | B) for matrices [begin, end), laid out like the batch itself
+    struct Workspace {
+        size_t n;
+        size_t width;
+        size_t lanes;
+        std::vector<T> data;
+        std::vector<T> det;
+
+        T& At(size_t i, size_t j, size_t k) {
+            return data[(i * width + j) * lanes + k];
+        }
+
+        // Gauss, or Gauss–Jordan if jordan is set, the same steps on every lane except
+        // for the pivot search and row swaps. A singular lane gets det 0 and garbage
+        void Eliminate(bool jordan) {
+            std::vector<T> inverse(lanes);
+            std::vector<T> factor(lanes);
+            for (size_t j = 0; j < n; ++j) {
+                for (size_t k = 0; k < lanes; ++k) {
+                    size_t pivot = j;
+                    while (pivot < n && At(pivot, j, k) == T::ZERO()) {
+                        ++pivot;
+                    }
+                    if (pivot == n) {
+                        det[k] = T::ZERO();
+                        inverse[k] = T::ZERO();
+                        continue;
+                    }
+                    if (pivot != j) {
+                        for (size_t c = j; c < width; ++c) {
+                            std::swap(At(pivot, c, k), At(j, c, k));
+                        }
+                        det[k] = -det[k];
+                    }
+                    det[k] *= At(j, j, k);
+                    inverse[k] = T::ONE() / At(j, j, k);
+                }
+                for (size_t c = j; c < width; ++c) {
+                    T* row = &At(j, c, 0);
+                    for (size_t k = 0; k < lanes; ++k) {
+                        row[k] *= inverse[k];
+                    }
+                }
+                for (size_t i = (jordan ? 0 : j + 1); i < n; ++i) {
+                    if (i == j) {
+                        continue;
+                    }
+                    std::copy_n(&At(i, j, 0), lanes, factor.begin());
+                    for (size_t c = j; c < width; ++c) {
+                        T* target = &At(i, c, 0);
+                        const T* source = &At(j, c, 0);
+                        for (size_t k = 0; k < lanes; ++k) {
+                            target[k] -= factor[k] * source[k];
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    size_t Index(size_t i, size_t j) const {
+        return (i * m_ + j) * count_;
+    }
+
+    template <typename F>
+    void ForChunks(F body) const {
+        size_t chunks = (count_ + LANES_PER_TASK - 1) / LANES_PER_TASK;
+        ThreadPool::Global().ParallelFor(chunks, [&](size_t chunk) {
+            size_t begin = chunk * LANES_PER_TASK;
+            body(begin, std::min(count_, begin + LANES_PER_TASK));
+        });
+    }
+
+    Workspace Load(size_t begin, size_t end, const MatrixBatch* rhs) const {
+        size_t extra = (rhs ? rhs->m_ : 0);
+        size_t lanes = end - begin;
+        Workspace work{n_, n_ + extra, lanes, std::vector<T>(n_ * (n_ + extra) * lanes, T::ZERO()),
+                       std::vector<T>(lanes, T::ONE())};
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t j = 0; j < n_; ++j) {
+                std::copy_n(&data_[Index(i, j) + begin], lanes, &work.At(i, j, 0));
+            }
+            for (size_t j = 0; j < extra; ++j) {
+                std::copy_n(&rhs->data_[rhs->Index(i, j) + begin], lanes, &work.At(i, n_ + j, 0));
+            }
+        }
+        return work;
+    }
+
+    // Coefficients of det(xI - A) for matrices [begin, end), t-th one of lane k at
+    // t * lanes + k. Adds one row and column at a time:
+    // p_(r+1)(x) = (x - a_rr) p_r(x) - sum_k (R A_r^k C) [p_r(x) / x^(k+1)]
+    // where A_r is the leading r x r block, C and R the rest of column and row r
+    std::vector<T> Berkowitz(size_t begin, size_t end) const {
+        size_t lanes = end - begin;
+        auto entry = [&](size_t i, size_t j) {
+            return &data_[Index(i, j) + begin];
+        };
+        std::vector<T> poly((n_ + 1) * lanes, T::ZERO());
+        std::fill_n(poly.begin(), lanes, T::ONE());
+        std::vector<T> next((n_ + 1) * lanes);
+        for (size_t r = 0; r < n_; ++r) {
+            std::vector<T> s(r * lanes, T::ZERO());
+            std::vector<T> v(r * lanes);
+            std::vector<T> w(r * lanes);
+            for (size_t i = 0; i < r; ++i) {
+                std::copy_n(entry(i, r), lanes, &v[i * lanes]);
+            }
+            for (size_t power = 0; power < r; ++power) {
+                for (size_t i = 0; i < r; ++i) {
+                    const T* row = entry(r, i);
+                    for (size_t k = 0; k < lanes; ++k) {
+                        s[power * lanes + k] += row[k] * v[i * lanes + k];
+                    }
+                }
+                if (power + 1 == r) {
+                    break;
+                }
+                std::fill(w.begin(), w.end(), T::ZERO());
+                for (size_t i = 0; i < r; ++i) {
+                    for (size_t j = 0; j < r; ++j) {
+                        const T* a = entry(i, j);
+                        for (size_t k = 0; k < lanes; ++k) {
+                            w[i * lanes + k] += a[k] * v[j * lanes + k];
+                        }
+                    }
+                }
+                std::swap(v, w);
+            }
+            const T* diagonal = entry(r, r);
+            for (size_t t = 0; t <= r + 1; ++t) {
+                for (size_t k = 0; k < lanes; ++k) {
+                    T value = (t > 0 ? poly[(t - 1) * lanes + k] : T::ZERO());
+                    if (t <= r) {
+                        value -= diagonal[k] * poly[t * lanes + k];
+                    }
+                    for (size_t power = 0; power < r && t + power + 1 <= r; ++power) {
+                        value -= s[power * lanes + k] * poly[(t + power + 1) * lanes + k];
+                    }
+                    next[t * lanes + k] = value;
+                }
+            }
+            std::swap(poly, next);
+        }
+        return poly;
+    }
+
+    size_t count_;
+    size_t n_;
+    size_t m_;
+    std::vector<T> data_;
+};
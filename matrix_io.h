@@ -0,0 +1,512 @@
+#pragma once
+
+#include "exceptions.h"
+#include "float.h"
+#include "fraction.h"
+#include "integer.h"
+#include "integer_mod.h"
+#include "matrix.h"
+#include "poly.h"
+#include "vector.h"
+
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary format, version 1. A 48 byte header of little endian fields
+//     char     magic[4]  "LAMX"
+//     uint32_t version
+//     uint32_t kind      BinaryKind
+//     uint32_t tag       element type, ScalarFormat<T>::TAG
+//     int64_t  modulus   of IntegerModulo, 0 for other types
+//     uint64_t rows
+//     uint64_t cols
+//     uint64_t reserved
+// followed by rows * cols elements in row-major order, each stored as
+// ScalarFormat<T>::Raw. A Vector of size n is n x 1, a Poly of degree d is
+// 1 x (d + 1) with the coefficients from x^0 up. The payload starts 8 byte
+// aligned, so a mapped file is read in place by MappedMatrix
+static_assert(std::endian::native == std::endian::little, "The binary format is little endian");
+
+enum class BinaryKind : uint32_t {
+    Matrix = 1,
+    Vector = 2,
+    Poly = 3,
+};
+
+// How a scalar type is stored and parsed. Types without a specialization
+// can't be read or written
+template <typename T>
+struct ScalarFormat;
+
+template <>
+struct ScalarFormat<Integer> {
+    using Raw = int64_t;
+    static constexpr uint32_t TAG = 1;
+    static constexpr int64_t MODULUS = 0;
+
+    static Raw ToRaw(const Integer& value) {
+        return static_cast<long long>(value);
+    }
+    static Integer FromRaw(Raw raw) {
+        return Integer(static_cast<long long>(raw));
+    }
+    static void Print(std::string& buffer, const Integer& value) {
+        FormatTo(buffer, value);
+    }
+    static const char* Parse(const char* first, const char* last, Integer& value) {
+        long long raw;
+        auto [end, error] = std::from_chars(first, last, raw);
+        if (error != std::errc()) {
+            return nullptr;
+        }
+        value = Integer(raw);
+        return end;
+    }
+};
+
+template <long long MOD>
+struct ScalarFormat<IntegerModulo<MOD>> {
+    using Raw = int64_t;
+    static constexpr uint32_t TAG = 2;
+    static constexpr int64_t MODULUS = MOD;
+
+    static Raw ToRaw(const IntegerModulo<MOD>& value) {
+        return static_cast<long long>(value);
+    }
+    static IntegerModulo<MOD> FromRaw(Raw raw) {
+        return IntegerModulo<MOD>(static_cast<long long>(raw));
+    }
+    static void Print(std::string& buffer, const IntegerModulo<MOD>& value) {
+        FormatTo(buffer, value);
+    }
+    static const char* Parse(const char* first, const char* last, IntegerModulo<MOD>& value) {
+        long long raw;
+        auto [end, error] = std::from_chars(first, last, raw);
+        if (error != std::errc()) {
+            return nullptr;
+        }
+        value = IntegerModulo<MOD>(raw);
+        return end;
+    }
+};
+
+template <>
+struct ScalarFormat<Float> {
+    using Raw = double;
+    static constexpr uint32_t TAG = 3;
+    static constexpr int64_t MODULUS = 0;
+
+    static Raw ToRaw(const Float& value) {
+        return static_cast<double>(value);
+    }
+    static Float FromRaw(Raw raw) {
+        return Float(raw);
+    }
+    // Shortest text that reads back to the same double, unlike FormatTo
+    static void Print(std::string& buffer, const Float& value) {
+        char digits[32];
+        buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), static_cast<double>(value)).ptr);
+    }
+    static const char* Parse(const char* first, const char* last, Float& value) {
+        double raw;
+        auto [end, error] = std::from_chars(first, last, raw);
+        if (error != std::errc()) {
+            return nullptr;
+        }
+        value = Float(raw);
+        return end;
+    }
+};
+
+// Text only: "a" or "a/b"
+template <>
+struct ScalarFormat<Fraction<Integer>> {
+    static void Print(std::string& buffer, const Fraction<Integer>& value) {
+        FormatTo(buffer, value.GetNumerator());
+        if (value.GetDenominator() != Integer::ONE()) {
+            buffer += '/';
+            FormatTo(buffer, value.GetDenominator());
+        }
+    }
+    static const char* Parse(const char* first, const char* last, Fraction<Integer>& value) {
+        long long numerator;
+        auto [end, error] = std::from_chars(first, last, numerator);
+        if (error != std::errc()) {
+            return nullptr;
+        }
+        long long denominator = 1;
+        if (end != last && *end == '/') {
+            auto [denominator_end, denominator_error] = std::from_chars(end + 1, last, denominator);
+            if (denominator_error != std::errc() || denominator == 0) {
+                return nullptr;
+            }
+            end = denominator_end;
+        }
+        value = Fraction<Integer>(Integer(numerator), Integer(denominator));
+        return end;
+    }
+};
+
+template <typename T>
+concept BinarySerializable = requires(const T& value, typename ScalarFormat<T>::Raw raw) {
+    ScalarFormat<T>::TAG;
+    { ScalarFormat<T>::ToRaw(value) } -> std::same_as<typename ScalarFormat<T>::Raw>;
+    { ScalarFormat<T>::FromRaw(raw) } -> std::same_as<T>;
+};
+
+// Print writes exactly what Parse reads back
+template <typename T>
+concept TextParsable = requires(const char* position, T& value, std::string& buffer) {
+    { ScalarFormat<T>::Parse(position, position, value) } -> std::same_as<const char*>;
+    ScalarFormat<T>::Print(buffer, value);
+};
+
+struct BinaryHeader {
+    char magic[4] = {'L', 'A', 'M', 'X'};
+    uint32_t version = VERSION;
+    BinaryKind kind;
+    uint32_t tag;
+    int64_t modulus;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t reserved = 0;
+
+    static constexpr uint32_t VERSION = 1;
+};
+
+static_assert(sizeof(BinaryHeader) == 48);
+
+template <BinarySerializable T>
+BinaryHeader MakeHeader(BinaryKind kind, size_t rows, size_t cols) {
+    BinaryHeader header;
+    header.kind = kind;
+    header.tag = ScalarFormat<T>::TAG;
+    header.modulus = ScalarFormat<T>::MODULUS;
+    header.rows = rows;
+    header.cols = cols;
+    return header;
+}
+
+// Throws FormatException unless header describes a file of file_size bytes
+// holding elements of type T
+template <BinarySerializable T>
+void CheckHeader(const BinaryHeader& header, size_t file_size) {
+    using Raw = typename ScalarFormat<T>::Raw;
+    BinaryHeader expected;
+    if (std::memcmp(header.magic, expected.magic, sizeof(expected.magic)) != 0 ||
+        header.version != BinaryHeader::VERSION || header.tag != ScalarFormat<T>::TAG ||
+        header.modulus != ScalarFormat<T>::MODULUS || file_size < sizeof(BinaryHeader)) {
+        throw FormatException();
+    }
+    if (header.cols != 0 && header.rows > (file_size - sizeof(BinaryHeader)) / sizeof(Raw) / header.cols) {
+        throw FormatException();
+    }
+    if (file_size != sizeof(BinaryHeader) + header.rows * header.cols * sizeof(Raw)) {
+        throw FormatException();
+    }
+}
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ != 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                int error = errno;
+                close(fd);
+                throw std::system_error(error, std::generic_category(), path);
+            }
+            data_ = static_cast<const char*>(data);
+            madvise(data, size_, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+
+    ~MappedFile() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    const char* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    std::string_view View() const {
+        return {data_, size_};
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Matrix stored in a binary file, read in place without copying the payload.
+// Vectors and polynomials open as n x 1 and 1 x (d + 1) matrices
+template <BinarySerializable T>
+class MappedMatrix {
+public:
+    using Raw = typename ScalarFormat<T>::Raw;
+
+    explicit MappedMatrix(const std::string& path) : file_(path) {
+        if (file_.size() < sizeof(BinaryHeader)) {
+            throw FormatException();
+        }
+        std::memcpy(&header_, file_.data(), sizeof(BinaryHeader));
+        CheckHeader<T>(header_, file_.size());
+    }
+
+    BinaryKind Kind() const {
+        return header_.kind;
+    }
+    size_t nsize() const {
+        return header_.rows;
+    }
+    size_t msize() const {
+        return header_.cols;
+    }
+
+    // The stored row itself, msize() elements
+    const Raw* Row(size_t i) const {
+        return reinterpret_cast<const Raw*>(file_.data() + sizeof(BinaryHeader)) + i * header_.cols;
+    }
+
+    T operator()(size_t i, size_t j) const {
+        return ScalarFormat<T>::FromRaw(Row(i)[j]);
+    }
+
+    Matrix<T> ToMatrix() const {
+        Matrix<T> ans(nsize(), msize());
+        for (size_t i = 0; i < nsize(); ++i) {
+            const Raw* row = Row(i);
+            for (size_t j = 0; j < msize(); ++j) {
+                ans[i][j] = ScalarFormat<T>::FromRaw(row[j]);
+            }
+        }
+        return ans;
+    }
+
+private:
+    MappedFile file_;
+    BinaryHeader header_;
+};
+
+namespace binary_io_detail {
+
+template <BinarySerializable T, typename Element>
+void Write(const std::string& path, BinaryKind kind, size_t rows, size_t cols, Element element) {
+    using Raw = typename ScalarFormat<T>::Raw;
+    std::ofstream out(path, std::ios::binary);
+    BinaryHeader header = MakeHeader<T>(kind, rows, cols);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<Raw> row(cols);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            row[j] = ScalarFormat<T>::ToRaw(element(i, j));
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(cols * sizeof(Raw)));
+    }
+    if (!out) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+}
+
+template <BinarySerializable T>
+MappedMatrix<T> Open(const std::string& path, BinaryKind kind) {
+    MappedMatrix<T> ans(path);
+    if (ans.Kind() != kind) {
+        throw FormatException();
+    }
+    return ans;
+}
+
+}  // namespace binary_io_detail
+
+template <BinarySerializable T>
+void WriteBinary(const std::string& path, const Matrix<T>& matrix) {
+    size_t n = matrix.nsize();
+    binary_io_detail::Write<T>(path, BinaryKind::Matrix, n, n ? matrix.msize() : 0,
+                               [&matrix](size_t i, size_t j) -> const T& { return matrix[i][j]; });
+}
+
+template <BinarySerializable T>
+void WriteBinary(const std::string& path, const Vector<T>& vector) {
+    binary_io_detail::Write<T>(path, BinaryKind::Vector, vector.size(), 1,
+                               [&vector](size_t i, size_t) -> const T& { return vector[i]; });
+}
+
+template <BinarySerializable T>
+void WriteBinary(const std::string& path, const Poly<T>& poly) {
+    std::vector<T> coefficients;
+    if (poly != Poly<T>::ZERO()) {
+        coefficients.assign(poly.deg() + 1, T::ZERO());
+        for (const auto& [power, coefficient] : poly.GetCoefficients()) {
+            coefficients[power] = coefficient;
+        }
+    }
+    binary_io_detail::Write<T>(path, BinaryKind::Poly, 1, coefficients.size(),
+                               [&coefficients](size_t, size_t j) -> const T& { return coefficients[j]; });
+}
+
+template <BinarySerializable T>
+Matrix<T> ReadBinaryMatrix(const std::string& path) {
+    return binary_io_detail::Open<T>(path, BinaryKind::Matrix).ToMatrix();
+}
+
+template <BinarySerializable T>
+Vector<T> ReadBinaryVector(const std::string& path) {
+    auto file = binary_io_detail::Open<T>(path, BinaryKind::Vector);
+    Vector<T> ans(file.nsize());
+    for (size_t i = 0; i < file.nsize(); ++i) {
+        ans[i] = file(i, 0);
+    }
+    return ans;
+}
+
+template <BinarySerializable T>
+Poly<T> ReadBinaryPoly(const std::string& path) {
+    auto file = binary_io_detail::Open<T>(path, BinaryKind::Poly);
+    std::vector<T> coefficients(file.msize());
+    for (size_t j = 0; j < file.msize(); ++j) {
+        coefficients[j] = file(0, j);
+    }
+    return Poly<T>(coefficients);
+}
+
+// Text: one row per line, elements separated by spaces or tabs, blank lines
+// skipped. Rows of different lengths throw WrongSizeException, anything that
+// isn't a number throws FormatException
+template <TextParsable T>
+Matrix<T> ParseMatrix(std::string_view text) {
+    const char* position = text.data();
+    const char* last = text.data() + text.size();
+    std::vector<T> elements;
+    size_t rows = 0;
+    size_t cols = 0;
+    while (position != last) {
+        size_t row_start = elements.size();
+        while (position != last && *position != '\n') {
+            if (*position == ' ' || *position == '\t' || *position == '\r') {
+                ++position;
+                continue;
+            }
+            T value;
+            position = ScalarFormat<T>::Parse(position, last, value);
+            if (!position) {
+                throw FormatException();
+            }
+            elements.push_back(std::move(value));
+        }
+        if (position != last) {
+            ++position;
+        }
+        size_t row_size = elements.size() - row_start;
+        if (row_size == 0) {
+            continue;
+        }
+        if (rows != 0 && row_size != cols) {
+            throw WrongSizeException();
+        }
+        cols = row_size;
+        ++rows;
+    }
+    Matrix<T> ans(rows, cols);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < cols; ++j) {
+            ans[i][j] = std::move(elements[i * cols + j]);
+        }
+    }
+    return ans;
+}
+
+// Text that ParseMatrix reads back to the same matrix
+template <TextParsable T>
+std::string PrintMatrix(const Matrix<T>& matrix) {
+    std::string ans;
+    size_t n = matrix.nsize();
+    size_t m = n ? matrix.msize() : 0;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+            if (j) {
+                ans += '\t';
+            }
+            ScalarFormat<T>::Print(ans, matrix[i][j]);
+        }
+        ans += '\n';
+    }
+    return ans;
+}
+
+// All the numbers of the text, whatever the line breaks
+template <TextParsable T>
+Vector<T> ParseVector(std::string_view text) {
+    const char* position = text.data();
+    const char* last = text.data() + text.size();
+    std::vector<T> elements;
+    while (position != last) {
+        if (*position == ' ' || *position == '\t' || *position == '\r' || *position == '\n') {
+            ++position;
+            continue;
+        }
+        T value;
+        position = ScalarFormat<T>::Parse(position, last, value);
+        if (!position) {
+            throw FormatException();
+        }
+        elements.push_back(std::move(value));
+    }
+    Vector<T> ans(elements.size());
+    for (size_t i = 0; i < elements.size(); ++i) {
+        ans[i] = std::move(elements[i]);
+    }
+    return ans;
+}
+
+// The file is mapped and parsed in place
+template <TextParsable T>
+Matrix<T> ReadTextMatrix(const std::string& path) {
+    return ParseMatrix<T>(MappedFile(path).View());
+}
+
+template <TextParsable T>
+Vector<T> ReadTextVector(const std::string& path) {
+    return ParseVector<T>(MappedFile(path).View());
+}
@@ -20,6 +20,19 @@ T fastpow(const T& a, size_t n) {
     return fastpow(a, n - 1) * a;
 }
 
+// Builds n * ONE with O(log n) additions, for rings without a constructor from int
+template<RingWithOne T>
+T FromInteger(long long n) {
+    if (n < 0) return -FromInteger<T>(-n);
+    T ans = T::ZERO();
+    T power = T::ONE();
+    for (; n > 0; n /= 2) {
+        if (n % 2 == 1) ans += power;
+        power += power;
+    }
+    return ans;
+}
+
 template<EuclideanRing T>
 T gcd(const T& a, const T& b) {
     if (b == T::ZERO()) {
@@ -0,0 +1,421 @@
+#pragma once
+
+#include "exceptions.h"
+#include "matrix_io.h"
+#include "myconcepts.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Matrices in the binary format of matrix_io.h that are too big for memory
+// are worked on block by block with pread/pwrite. Every algorithm takes a
+// memory budget in bytes and keeps its blocks, including the ones being
+// prefetched or written behind on a separate thread, within it. Each one
+// documents the smallest budget it can work in and throws
+// MemoryBudgetException below that rather than going over. I/O goes to
+// std::async threads rather than to the ThreadPool so that a blocked read
+// never takes a worker away from the arithmetic
+template <BinarySerializable T>
+class TiledFile {
+public:
+    using Raw = typename ScalarFormat<T>::Raw;
+
+    // An existing matrix file
+    explicit TiledFile(const std::string& path) : fd_(open(path.c_str(), O_RDONLY)) {
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        try {
+            struct stat info;
+            if (fstat(fd_, &info) < 0) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+            BinaryHeader header;
+            if (static_cast<size_t>(info.st_size) < sizeof(header)) {
+                throw FormatException();
+            }
+            ReadBytes(0, &header, sizeof(header));
+            CheckHeader<T>(header, static_cast<size_t>(info.st_size));
+            if (header.kind != BinaryKind::Matrix) {
+                throw FormatException();
+            }
+            rows_ = header.rows;
+            cols_ = header.cols;
+        } catch (...) {
+            close(fd_);
+            throw;
+        }
+    }
+
+    // A new rows x cols matrix file, zero filled
+    static TiledFile Create(const std::string& path, size_t rows, size_t cols) {
+        return TiledFile(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644), path, rows, cols);
+    }
+
+    // A rows x cols file in the directory of path that is deleted once closed
+    static TiledFile Scratch(const std::string& path, size_t rows, size_t cols) {
+        std::string name = path + ".XXXXXX";
+        int fd = mkstemp(name.data());
+        if (fd >= 0) {
+            unlink(name.c_str());
+        }
+        return TiledFile(fd, name, rows, cols);
+    }
+
+    TiledFile(const TiledFile& other) = delete;
+    TiledFile& operator=(const TiledFile& other) = delete;
+    TiledFile(TiledFile&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1)), rows_(other.rows_), cols_(other.cols_) {}
+    TiledFile& operator=(TiledFile&& other) noexcept {
+        std::swap(fd_, other.fd_);
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        return *this;
+    }
+
+    ~TiledFile() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    size_t nsize() const {
+        return rows_;
+    }
+    size_t msize() const {
+        return cols_;
+    }
+
+    // The block [row, row + rows) x [col, col + cols), row-major
+    std::vector<T> Read(size_t row, size_t col, size_t rows, size_t cols) const {
+        std::vector<T> ans;
+        ans.reserve(rows * cols);
+        std::vector<Raw> raw(cols);
+        for (size_t i = 0; i < rows; ++i) {
+            ReadBytes(Offset(row + i, col), raw.data(), cols * sizeof(Raw));
+            for (size_t j = 0; j < cols; ++j) {
+                ans.push_back(ScalarFormat<T>::FromRaw(raw[j]));
+            }
+        }
+        return ans;
+    }
+
+    void Write(size_t row, size_t col, size_t rows, size_t cols, const std::vector<T>& block) {
+        std::vector<Raw> raw(cols);
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                raw[j] = ScalarFormat<T>::ToRaw(block[i * cols + j]);
+            }
+            WriteBytes(Offset(row + i, col), raw.data(), cols * sizeof(Raw));
+        }
+    }
+
+private:
+    TiledFile(int fd, const std::string& path, size_t rows, size_t cols) : fd_(fd), rows_(rows), cols_(cols) {
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        try {
+            BinaryHeader header = MakeHeader<T>(BinaryKind::Matrix, rows, cols);
+            WriteBytes(0, &header, sizeof(header));
+            if (ftruncate(fd_, static_cast<off_t>(Offset(rows, 0))) < 0) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+        } catch (...) {
+            close(fd_);
+            throw;
+        }
+    }
+
+    size_t Offset(size_t row, size_t col) const {
+        return sizeof(BinaryHeader) + (row * cols_ + col) * sizeof(Raw);
+    }
+
+    void ReadBytes(size_t offset, void* data, size_t size) const {
+        char* position = static_cast<char*>(data);
+        while (size != 0) {
+            ssize_t done = pread(fd_, position, size, static_cast<off_t>(offset));
+            if (done < 0 && errno == EINTR) {
+                continue;
+            }
+            if (done <= 0) {
+                throw std::system_error(done < 0 ? errno : EIO, std::generic_category(), "pread");
+            }
+            position += done;
+            offset += static_cast<size_t>(done);
+            size -= static_cast<size_t>(done);
+        }
+    }
+
+    void WriteBytes(size_t offset, const void* data, size_t size) {
+        const char* position = static_cast<const char*>(data);
+        while (size != 0) {
+            ssize_t done = pwrite(fd_, position, size, static_cast<off_t>(offset));
+            if (done < 0 && errno == EINTR) {
+                continue;
+            }
+            if (done <= 0) {
+                throw std::system_error(done < 0 ? errno : EIO, std::generic_category(), "pwrite");
+            }
+            position += done;
+            offset += static_cast<size_t>(done);
+            size -= static_cast<size_t>(done);
+        }
+    }
+
+    int fd_;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+};
+
+// Writes a * b to result. Tiles are square, five of them fit in the budget:
+// the current pair of a and b, the next pair being read and the result tile,
+// along with a row of Raw for each of the two reads and the write. So the
+// budget must be at least 5 * sizeof(T) + 3 * sizeof(Raw), for 1 x 1 tiles
+template <BinarySerializable T>
+void MultiplyOutOfCore(const std::string& a_path, const std::string& b_path, const std::string& result_path,
+                       size_t memory_budget) {
+    using Raw = typename TiledFile<T>::Raw;
+    TiledFile<T> a(a_path);
+    TiledFile<T> b(b_path);
+    if (a.msize() != b.nsize()) {
+        throw WrongSizeException();
+    }
+    auto resident = [](size_t tile) {
+        return 5 * tile * tile * sizeof(T) + 3 * tile * sizeof(Raw);
+    };
+    size_t tile = static_cast<size_t>(std::sqrt(memory_budget / (5 * sizeof(T))));
+    while (tile > 0 && resident(tile) > memory_budget) {
+        --tile;
+    }
+    if (tile == 0) {
+        throw MemoryBudgetException();
+    }
+    size_t n = a.nsize();
+    size_t m = a.msize();
+    size_t p = b.msize();
+    // Created zero filled, which is already the answer when m is 0
+    TiledFile<T> result = TiledFile<T>::Create(result_path, n, p);
+
+    struct Step {
+        size_t i, j, k;
+    };
+    std::vector<Step> steps;
+    for (size_t i = 0; i < n; i += tile) {
+        for (size_t j = 0; j < p; j += tile) {
+            for (size_t k = 0; k < m; k += tile) {
+                steps.push_back({i, j, k});
+            }
+        }
+    }
+    auto fetch = [&](const Step& step) {
+        return std::async(std::launch::async, [&a, &b, step, tile, n, m, p] {
+            return std::pair(a.Read(step.i, step.k, std::min(tile, n - step.i), std::min(tile, m - step.k)),
+                             b.Read(step.k, step.j, std::min(tile, m - step.k), std::min(tile, p - step.j)));
+        });
+    };
+
+    std::future<std::pair<std::vector<T>, std::vector<T>>> next;
+    if (!steps.empty()) {
+        next = fetch(steps[0]);
+    }
+    std::vector<T> c;
+    for (size_t s = 0; s < steps.size(); ++s) {
+        auto [a_tile, b_tile] = next.get();
+        if (s + 1 < steps.size()) {
+            next = fetch(steps[s + 1]);
+        }
+        const Step& step = steps[s];
+        size_t rows = std::min(tile, n - step.i);
+        size_t cols = std::min(tile, p - step.j);
+        size_t inner = std::min(tile, m - step.k);
+        if (step.k == 0) {
+            c.assign(rows * cols, T::ZERO());
+        }
+        ThreadPool::Global().ParallelFor(rows, [&](size_t i) {
+            for (size_t k = 0; k < inner; ++k) {
+                const T& coefficient = a_tile[i * inner + k];
+                if (coefficient == T::ZERO()) {
+                    continue;
+                }
+                for (size_t j = 0; j < cols; ++j) {
+                    c[i * cols + j] += coefficient * b_tile[k * cols + j];
+                }
+            }
+        });
+        if (step.k + tile >= m) {
+            result.Write(step.i, step.j, rows, cols, c);
+        }
+    }
+}
+
+template <RingWithOne T>
+struct EliminationResult {
+    size_t rank;
+    T det;  // Only for square matrices, 0 unless the rank is full
+};
+
+// Gaussian elimination of a working copy, one panel of columns at a time. A
+// panel holds every remaining row of `width` columns; it is eliminated in
+// memory, then the same row operations are applied to the columns to its
+// right, block by block: swaps first, then the pivot rows among themselves,
+// then every other row (in parallel). Pivots are the first non-zero entries,
+// as in Det, so results agree with the in-memory ones. Panels and blocks
+// are full height, so the budget must hold at least four n x 1 columns and
+// two Raw entries, 4 * n * sizeof(T) + 2 * sizeof(Raw)
+template <BinarySerializable T>
+    requires Field<T>
+EliminationResult<T> EliminateOutOfCore(const std::string& path, size_t memory_budget) {
+    using Raw = typename TiledFile<T>::Raw;
+    TiledFile<T> input(path);
+    size_t n = input.nsize();
+    size_t m = input.msize();
+    // The panel, the block being updated, the one being read and the one
+    // being written, plus a row of Raw for the read and the write
+    size_t width = memory_budget / (4 * std::max<size_t>(n, 1) * sizeof(T) + 2 * sizeof(Raw));
+    if (width == 0) {
+        throw MemoryBudgetException();
+    }
+
+    TiledFile<T> work = TiledFile<T>::Scratch(path, n, m);
+    for (size_t col = 0; col < m; col += width) {
+        size_t cols = std::min(width, m - col);
+        work.Write(0, col, n, cols, input.Read(0, col, n, cols));
+    }
+
+    T det = T::ONE();
+    size_t start = 0;
+    for (size_t col = 0; col < m && start < n; col += width) {
+        size_t rows = n - start;
+        size_t cols = std::min(width, m - col);
+        std::vector<T> panel = work.Read(start, col, rows, cols);
+        std::vector<size_t> swaps;
+        std::vector<size_t> pivot_columns;
+        for (size_t j = 0; j < cols && swaps.size() < rows; ++j) {
+            size_t pivot = swaps.size();
+            size_t found = pivot;
+            while (found < rows && panel[found * cols + j] == T::ZERO()) {
+                ++found;
+            }
+            if (found == rows) {
+                continue;
+            }
+            if (found != pivot) {
+                std::swap_ranges(panel.begin() + found * cols, panel.begin() + (found + 1) * cols,
+                                 panel.begin() + pivot * cols);
+                det = -det;
+            }
+            swaps.push_back(found);
+            pivot_columns.push_back(j);
+            const T& value = panel[pivot * cols + j];
+            det *= value;
+            for (size_t i = pivot + 1; i < rows; ++i) {
+                if (panel[i * cols + j] == T::ZERO()) {
+                    continue;
+                }
+                T factor = panel[i * cols + j] / value;
+                for (size_t k = j + 1; k < cols; ++k) {
+                    panel[i * cols + k] -= factor * panel[pivot * cols + k];
+                }
+                // Below the pivot the column is zero now, so it keeps the factor
+                panel[i * cols + j] = factor;
+            }
+        }
+        size_t pivots = swaps.size();
+        if (pivots == 0) {
+            continue;
+        }
+
+        auto update = [&](std::vector<T>& block, size_t block_cols) {
+            for (size_t p = 0; p < pivots; ++p) {
+                if (swaps[p] != p) {
+                    std::swap_ranges(block.begin() + swaps[p] * block_cols, block.begin() + (swaps[p] + 1) * block_cols,
+                                     block.begin() + p * block_cols);
+                }
+            }
+            auto eliminate = [&](size_t i, size_t pivot_count) {
+                for (size_t p = 0; p < pivot_count; ++p) {
+                    const T& factor = panel[i * cols + pivot_columns[p]];
+                    if (factor == T::ZERO()) {
+                        continue;
+                    }
+                    for (size_t k = 0; k < block_cols; ++k) {
+                        block[i * block_cols + k] -= factor * block[p * block_cols + k];
+                    }
+                }
+            };
+            for (size_t i = 1; i < pivots; ++i) {
+                eliminate(i, i);
+            }
+            ThreadPool::Global().ParallelFor(rows - pivots, [&](size_t i) {
+                eliminate(pivots + i, pivots);
+            });
+        };
+
+        std::vector<size_t> blocks;
+        for (size_t block_col = col + cols; block_col < m; block_col += width) {
+            blocks.push_back(block_col);
+        }
+        auto fetch = [&](size_t block_col) {
+            return std::async(std::launch::async, [&work, start, rows, block_col, width, m] {
+                return work.Read(start, block_col, rows, std::min(width, m - block_col));
+            });
+        };
+        std::future<std::vector<T>> next;
+        std::future<void> written;
+        if (!blocks.empty()) {
+            next = fetch(blocks[0]);
+        }
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            std::vector<T> block = next.get();
+            if (b + 1 < blocks.size()) {
+                next = fetch(blocks[b + 1]);
+            }
+            size_t block_cols = std::min(width, m - blocks[b]);
+            update(block, block_cols);
+            if (written.valid()) {
+                written.get();
+            }
+            written = std::async(std::launch::async, [&work, start, rows, block_col = blocks[b], block_cols,
+                                                      block = std::move(block)] {
+                work.Write(start, block_col, rows, block_cols, block);
+            });
+        }
+        if (written.valid()) {
+            written.get();
+        }
+        start += pivots;
+    }
+    if (start < n || n != m) {
+        det = T::ZERO();
+    }
+    return {start, det};
+}
+
+template <BinarySerializable T>
+    requires Field<T>
+T DetOutOfCore(const std::string& path, size_t memory_budget) {
+    TiledFile<T> input(path);
+    if (input.nsize() != input.msize()) {
+        throw WrongSizeException();
+    }
+    return EliminateOutOfCore<T>(path, memory_budget).det;
+}
+
+template <BinarySerializable T>
+    requires Field<T>
+size_t RankOutOfCore(const std::string& path, size_t memory_budget) {
+    return EliminateOutOfCore<T>(path, memory_budget).rank;
+}
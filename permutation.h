@@ -1,10 +1,17 @@
 #pragma once
 
+#include "thread_pool.h"
+
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <optional>
+#include <type_traits>
 #include <vector>
 
 class Permutation {
@@ -14,10 +21,15 @@ public:
         std::iota(data_.begin(), data_.end(), 0);
     }
     Permutation(const std::vector<size_t>& data) : data_(data) {}
-    Permutation(const std::initializer_list<size_t>& data) {
-        *this = data;
-    }
+    Permutation(const std::initializer_list<size_t>& data) : data_(data) {}
     Permutation(const std::initializer_list<std::initializer_list<size_t>>& cycles) {
+        size_t n = 0;
+        for (const auto& cycle : cycles) {
+            for (const auto& elem : cycle) {
+                n = std::max(n, elem + 1);
+            }
+        }
+        data_.resize(n);
         *this = cycles;
     }
     Permutation(const Permutation& other) = default;
@@ -26,6 +38,7 @@ public:
     Permutation& operator=(const Permutation& other) = default;
     Permutation& operator=(Permutation&& other) = default;
     Permutation& operator=(const std::initializer_list<size_t>& data) {
+        Invalidate();
         size_t i = 0;
         for (auto it = data.begin(); it != data.end(); ++i, ++it) {
             data_[i] = *it;
@@ -33,6 +46,7 @@ public:
         return *this;
     }
     Permutation& operator=(const std::initializer_list<std::initializer_list<size_t>>& cycles) {
+        Invalidate();
         std::iota(data_.begin(), data_.end(), 0);
         for (const auto& cycle : cycles) {
             size_t start = *cycle.begin();
@@ -57,8 +71,12 @@ public:
         return *this = *this * other;
     }
 
-    bool operator==(const Permutation& other) const = default;
-    bool operator!=(const Permutation& other) const = default;
+    bool operator==(const Permutation& other) const {
+        return data_ == other.data_;
+    }
+    bool operator!=(const Permutation& other) const {
+        return data_ != other.data_;
+    }
 
     Permutation Inverse() const {
         Permutation ans(size());
@@ -67,10 +85,20 @@ public:
         }
         return ans;
     }
+    // Every cycle is shifted by indicator mod its length, so it's O(n) for any indicator
     Permutation Power(size_t indicator) const {
-        if (indicator == 0) return Permutation(size());
-        if (indicator % 2 == 0) return (*this * *this).Power(indicator / 2);
-        return Power(indicator - 1) * *this;
+        const auto& cycles = GetCycles();
+        Permutation ans(size());
+        for (size_t c = 0; c + 1 < cycles.starts.size(); ++c) {
+            size_t start = cycles.starts[c];
+            size_t len = cycles.starts[c + 1] - start;
+            size_t shift = indicator % len;
+            for (size_t j = 0; j < len; ++j) {
+                size_t to = j + shift < len ? j + shift : j + shift - len;
+                ans.data_[cycles.points[start + j]] = cycles.points[start + to];
+            }
+        }
+        return ans;
     }
 
     size_t operator[](size_t ind) const {
@@ -82,29 +110,88 @@ public:
     }
 
     int sign() const {
+        return GetCycles().sign;
+    }
+
+    // lcm of cycle lengths; overflows only for huge n
+    size_t Order() const {
+        const auto& cycles = GetCycles();
+        size_t ans = 1;
+        for (size_t c = 0; c + 1 < cycles.starts.size(); ++c) {
+            ans = std::lcm(ans, cycles.starts[c + 1] - cycles.starts[c]);
+        }
+        return ans;
+    }
+
+    // Lengths of all cycles (fixed points included) in non-increasing order
+    std::vector<size_t> CycleType() const {
+        const auto& cycles = GetCycles();
+        std::vector<size_t> ans;
+        for (size_t c = 0; c + 1 < cycles.starts.size(); ++c) {
+            ans.push_back(cycles.starts[c + 1] - cycles.starts[c]);
+        }
+        std::sort(ans.begin(), ans.end(), std::greater<size_t>());
+        return ans;
+    }
+
+    // Cycles of the permutation, each one as a list of points x, p(x), p(p(x)), ...
+    std::vector<std::vector<size_t>> Cycles() const {
+        const auto& cycles = GetCycles();
+        std::vector<std::vector<size_t>> ans;
+        for (size_t c = 0; c + 1 < cycles.starts.size(); ++c) {
+            ans.emplace_back(cycles.points.begin() + cycles.starts[c], cycles.points.begin() + cycles.starts[c + 1]);
+        }
+        return ans;
+    }
+
+    friend class AllPermutations;
+    friend class PermutationShard;
+
+private:
+    // All cycles written one after another: cycle c is points[starts[c], starts[c + 1])
+    struct CycleDecomposition {
+        std::vector<size_t> points;
+        std::vector<size_t> starts;
+        int sign;
+    };
+
+    // Computed on first use and shared between copies. Atomic access keeps
+    // concurrent readers of one const permutation safe
+    const CycleDecomposition& GetCycles() const {
+        auto cycles = std::atomic_load(&cycles_);
+        if (cycles) {
+            return *cycles;
+        }
+        auto computed = std::make_shared<CycleDecomposition>();
+        computed->points.reserve(size());
         std::vector<bool> used(size(), false);
-        size_t cmp_comps = 0;
         for (size_t i = 0; i < size(); ++i) {
-            if (!used[i]) {
-                size_t vertex = i;
-                while (!used[vertex]) {
-                    used[vertex] = true;
-                    vertex = data_[vertex];
-                }
-                ++cmp_comps;
+            if (used[i]) {
+                continue;
+            }
+            computed->starts.push_back(computed->points.size());
+            for (size_t vertex = i; !used[vertex]; vertex = data_[vertex]) {
+                used[vertex] = true;
+                computed->points.push_back(vertex);
             }
         }
-        return ((size() - cmp_comps) % 2 == 0 ? 1 : -1);
+        size_t cycles_count = computed->starts.size();
+        computed->starts.push_back(size());
+        computed->sign = ((size() - cycles_count) % 2 == 0 ? 1 : -1);
+        std::shared_ptr<const CycleDecomposition> expected;
+        std::atomic_compare_exchange_strong(&cycles_, &expected, std::shared_ptr<const CycleDecomposition>(computed));
+        return *std::atomic_load(&cycles_);
     }
 
-    friend class AllPermutations;
+    void Invalidate() {
+        cycles_.reset();
+    }
 
-private:
     std::vector<size_t> data_;
+    mutable std::shared_ptr<const CycleDecomposition> cycles_;
 };
 
-template<size_t n>
-std::ostream& operator<<(std::ostream& stream, const Permutation& p) {
+inline std::ostream& operator<<(std::ostream& stream, const Permutation& p) {
     for (size_t i = 0; i < p.size(); ++i) {
         stream << p[i] + 1 << ' ';
     }
@@ -117,7 +204,7 @@ public:
     public:
         Iterator(size_t n, bool is_end = false): p_(n), is_end_(is_end), n_(n) {}
 
-        Iterator operator++() {
+        Iterator& operator++() {
             for (ssize_t i = n_ - 2; i >= 0; --i) {
                 if (p_.data_[i + 1] > p_.data_[i]) {
                     size_t to_swap = n_ - 1;
@@ -126,6 +213,7 @@ public:
                             to_swap = j;
                         }
                     }
+                    p_.Invalidate();
                     std::swap(p_.data_[to_swap], p_.data_[i]);
                     std::reverse(p_.data_.begin() + i + 1, p_.data_.end());
                     return *this;
@@ -170,3 +258,183 @@ public:
 private:
     size_t n_;
 };
+
+// All permutations starting with a fixed prefix. They are visited in Heap's
+// order: every step is a single transposition, so the sign is updated in O(1)
+// and the permutation is never copied
+class PermutationShard {
+public:
+    PermutationShard(size_t n, const std::vector<size_t>& prefix) : start_(n), prefix_size_(prefix.size()) {
+        std::vector<bool> used(n, false);
+        for (size_t i = 0; i < prefix.size(); ++i) {
+            start_.data_[i] = prefix[i];
+            used[prefix[i]] = true;
+        }
+        size_t pos = prefix.size();
+        for (size_t i = 0; i < n; ++i) {
+            if (!used[i]) {
+                start_.data_[pos++] = i;
+            }
+        }
+        sign_ = start_.sign();
+    }
+
+    // Calls visit(permutation, sign) for every permutation of the shard.
+    // If visit returns bool, returning true stops the walk
+    template <typename F>
+    void ForEach(F visit) const {
+        Permutation p = start_;
+        int sign = sign_;
+        if (Visit(visit, p, sign)) {
+            return;
+        }
+        size_t* a = p.data_.data() + prefix_size_;
+        size_t m = p.size() - prefix_size_;
+        std::vector<size_t> counters(m, 0);
+        for (size_t i = 1; i < m;) {
+            if (counters[i] < i) {
+                p.Invalidate();
+                std::swap(a[i % 2 == 0 ? 0 : counters[i]], a[i]);
+                sign = -sign;
+                if (Visit(visit, p, sign)) {
+                    return;
+                }
+                ++counters[i];
+                i = 1;
+            } else {
+                counters[i] = 0;
+                ++i;
+            }
+        }
+    }
+
+private:
+    template <typename F>
+    static bool Visit(F& visit, const Permutation& p, int sign) {
+        if constexpr (std::is_same_v<std::invoke_result_t<F&, const Permutation&, int>, bool>) {
+            return visit(p, sign);
+        } else {
+            visit(p, sign);
+            return false;
+        }
+    }
+
+    Permutation start_;
+    size_t prefix_size_;
+    int sign_;
+};
+
+// Enumerates S_n split into disjoint prefix shards which run on a thread pool.
+// Results are always combined in shard order, so they don't depend on scheduling
+class PermutationEngine {
+public:
+    PermutationEngine(size_t n, ThreadPool& pool = ThreadPool::Global()) : n_(n), pool_(pool) {
+        // Enough shards to keep every thread busy even if shards are uneven
+        size_t wanted = 4 * pool_.size();
+        size_t count = 1;
+        size_t depth = 0;
+        while (depth + 1 < n_ && count < wanted) {
+            count *= n_ - depth;
+            ++depth;
+        }
+        std::vector<size_t> prefix;
+        std::vector<bool> used(n_, false);
+        MakeShards(depth, prefix, used);
+    }
+
+    const std::vector<PermutationShard>& GetShards() const {
+        return shards_;
+    }
+
+    // Every shard folds its permutations into its own copy of init with
+    // fold(acc, p, sign), then the copies are merged with combine(acc, other)
+    template <typename R, typename Fold, typename Combine>
+    R Reduce(const R& init, Fold fold, Combine combine) const {
+        std::vector<R> partial(shards_.size(), init);
+        pool_.ParallelFor(shards_.size(), [&](size_t i) {
+            shards_[i].ForEach([&](const Permutation& p, int sign) {
+                fold(partial[i], p, sign);
+            });
+        });
+        R ans = init;
+        for (const auto& elem : partial) {
+            combine(ans, elem);
+        }
+        return ans;
+    }
+
+    // Sum of f(p, sign) over all permutations
+    template <typename R, typename F>
+    R Sum(const R& zero, F f) const {
+        return Reduce(zero, [&](R& acc, const Permutation& p, int sign) {
+            acc += f(p, sign);
+        }, [](R& acc, const R& other) {
+            acc += other;
+        });
+    }
+
+    template <typename Pred>
+    size_t Count(Pred pred) const {
+        return Sum(size_t(0), [&](const Permutation& p, int) -> size_t {
+            return pred(p) ? 1 : 0;
+        });
+    }
+
+    // All permutations satisfying pred, in shard order
+    template <typename Pred>
+    std::vector<Permutation> FindAll(Pred pred) const {
+        return Reduce(std::vector<Permutation>(), [&](std::vector<Permutation>& acc, const Permutation& p, int) {
+            if (pred(p)) {
+                acc.push_back(p);
+            }
+        }, [](std::vector<Permutation>& acc, const std::vector<Permutation>& other) {
+            acc.insert(acc.end(), other.begin(), other.end());
+        });
+    }
+
+    // Some permutation satisfying pred; all shards stop as soon as one is found
+    template <typename Pred>
+    std::optional<Permutation> FindAny(Pred pred) const {
+        std::atomic<bool> found = false;
+        std::optional<Permutation> ans;
+        std::mutex mutex;
+        pool_.ParallelFor(shards_.size(), [&](size_t i) {
+            shards_[i].ForEach([&](const Permutation& p, int) {
+                if (found) {
+                    return true;
+                }
+                if (!pred(p)) {
+                    return false;
+                }
+                std::lock_guard lock(mutex);
+                if (!found.exchange(true)) {
+                    ans = p;
+                }
+                return true;
+            });
+        });
+        return ans;
+    }
+
+private:
+    void MakeShards(size_t depth, std::vector<size_t>& prefix, std::vector<bool>& used) {
+        if (prefix.size() == depth) {
+            shards_.emplace_back(n_, prefix);
+            return;
+        }
+        for (size_t i = 0; i < n_; ++i) {
+            if (used[i]) {
+                continue;
+            }
+            used[i] = true;
+            prefix.push_back(i);
+            MakeShards(depth, prefix, used);
+            prefix.pop_back();
+            used[i] = false;
+        }
+    }
+
+    size_t n_;
+    ThreadPool& pool_;
+    std::vector<PermutationShard> shards_;
+};
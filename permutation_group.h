@@ -0,0 +1,231 @@
+#pragma once
+
+#include "exceptions.h"
+#include "permutation.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Permutation group given by generators. Keeps a stabilizer chain built with
+// Schreier–Sims: level k holds generators of the pointwise stabilizer of
+// base_[0..k) and a transversal of the orbit of base_[k] under it. Every group
+// element is uniquely a product transversal_[0][x0] * ... * transversal_[n-1][x(n-1)]
+class PermutationGroup {
+public:
+    PermutationGroup(size_t n) : PermutationGroup(n, {}) {}
+    PermutationGroup(size_t n, const std::vector<Permutation>& generators) : PermutationGroup(n, generators, {}) {}
+    // base_prefix is used as the beginning of the base, the rest of points follows in order
+    PermutationGroup(size_t n, const std::vector<Permutation>& generators, const std::vector<size_t>& base_prefix)
+        : n_(n), base_(base_prefix), generators_(n), transversal_(n, std::vector<std::optional<Permutation>>(n)) {
+        std::vector<bool> used(n, false);
+        for (size_t point : base_) {
+            used[point] = true;
+        }
+        for (size_t point = 0; point < n; ++point) {
+            if (!used[point]) {
+                base_.push_back(point);
+            }
+        }
+        for (size_t k = 0; k < n; ++k) {
+            transversal_[k][base_[k]] = Permutation(n);
+        }
+        for (const auto& generator : generators) {
+            if (generator.size() != n) {
+                throw WrongSizeException();
+            }
+            Extend(0, generator);
+        }
+    }
+
+    size_t degree() const {
+        return n_;
+    }
+
+    // Overflows for groups bigger than 20!
+    size_t Order() const {
+        size_t ans = 1;
+        for (size_t k = 0; k < n_; ++k) {
+            ans *= OrbitSize(k);
+        }
+        return ans;
+    }
+
+    bool Contains(const Permutation& p) const {
+        return p.size() == n_ && Sift(p, 0);
+    }
+
+    // Points with nontrivial basic orbits
+    std::vector<size_t> GetBase() const {
+        std::vector<size_t> ans;
+        for (size_t k = 0; k < n_; ++k) {
+            if (OrbitSize(k) > 1) {
+                ans.push_back(base_[k]);
+            }
+        }
+        return ans;
+    }
+
+    std::vector<Permutation> GetStrongGenerators() const {
+        std::vector<Permutation> ans;
+        for (const auto& level : generators_) {
+            ans.insert(ans.end(), level.begin(), level.end());
+        }
+        return ans;
+    }
+
+    // Pointwise stabilizer of the first k points of the full base
+    PermutationGroup Stabilizer(size_t k) const {
+        std::vector<Permutation> generators;
+        for (size_t level = k; level < n_; ++level) {
+            generators.insert(generators.end(), generators_[level].begin(), generators_[level].end());
+        }
+        return PermutationGroup(n_, generators, base_);
+    }
+
+    size_t OrbitSize(size_t k) const {
+        return std::count_if(transversal_[k].begin(), transversal_[k].end(), [](const auto& t) {
+            return t.has_value();
+        });
+    }
+
+    // Backtrack over the group, level by level of the chain. At depth d the
+    // images of base points base_[0..d) are fixed, and prune(d, h) is asked whether
+    // it's worth going deeper: h is any permutation with those images, and the
+    // whole branch is skipped when prune returns false. Returns an element
+    // satisfying pred, if any
+    template <typename Pred, typename Prune>
+    std::optional<Permutation> Search(Pred pred, Prune prune) const {
+        std::optional<Permutation> ans;
+        Backtrack(0, Permutation(n_), pred, prune, [&ans](const Permutation& p) {
+            ans = p;
+            return true;
+        });
+        return ans;
+    }
+
+    template <typename Pred>
+    std::optional<Permutation> Search(Pred pred) const {
+        return Search(pred, [](size_t, const Permutation&) { return true; });
+    }
+
+    template <typename Pred, typename Prune>
+    std::vector<Permutation> SearchAll(Pred pred, Prune prune) const {
+        std::vector<Permutation> ans;
+        Backtrack(0, Permutation(n_), pred, prune, [&ans](const Permutation& p) {
+            ans.push_back(p);
+            return false;
+        });
+        return ans;
+    }
+
+    // Some g from the group with g * a * g^-1 = b
+    std::optional<Permutation> FindConjugator(const Permutation& a, const Permutation& b) const {
+        if (a.size() != n_ || b.size() != n_ || a.CycleType() != b.CycleType()) {
+            return std::nullopt;
+        }
+        // Base runs along cycles of a, so that g(a(x)) = b(g(x)) can be checked as soon as
+        // both images are known
+        std::vector<size_t> base;
+        std::vector<bool> used(n_, false);
+        for (size_t start = 0; start < n_; ++start) {
+            for (size_t x = start; !used[x]; x = a[x]) {
+                used[x] = true;
+                base.push_back(x);
+            }
+        }
+        PermutationGroup rebased(n_, GetStrongGenerators(), base);
+        Permutation a_inverse = a.Inverse();
+        return rebased.Search([&a, &b](const Permutation& g) {
+            return g * a == b * g;
+        }, [&](size_t depth, const Permutation& h) {
+            size_t x = rebased.base_[depth - 1];
+            size_t next = a[x];
+            size_t prev = a_inverse[x];
+            if (rebased.BasePosition(next) < depth && h[next] != b[h[x]]) {
+                return false;
+            }
+            return rebased.BasePosition(prev) >= depth || h[x] == b[h[prev]];
+        });
+    }
+
+    bool AreConjugate(const Permutation& a, const Permutation& b) const {
+        return FindConjugator(a, b).has_value();
+    }
+
+private:
+    size_t BasePosition(size_t point) const {
+        return std::find(base_.begin(), base_.end(), point) - base_.begin();
+    }
+
+    // Whether p belongs to the stabilizer at level k
+    bool Sift(Permutation p, size_t k) const {
+        for (; k < n_; ++k) {
+            const auto& t = transversal_[k][p[base_[k]]];
+            if (!t) {
+                return false;
+            }
+            p = t->Inverse() * p;
+        }
+        return true;
+    }
+
+    // Adds p (which fixes base_[0..k)) to the stabilizer at level k
+    void Extend(size_t k, const Permutation& p) {
+        if (Sift(p, k)) {
+            return;
+        }
+        generators_[k].push_back(p);
+        std::vector<size_t> orbit;
+        for (size_t x = 0; x < n_; ++x) {
+            if (transversal_[k][x]) {
+                orbit.push_back(x);
+            }
+        }
+        for (size_t x : orbit) {
+            Update(k, p * *transversal_[k][x]);
+        }
+    }
+
+    // t maps base_[k] somewhere: either a new orbit point or a Schreier generator for level k + 1
+    void Update(size_t k, const Permutation& t) {
+        size_t x = t[base_[k]];
+        if (transversal_[k][x]) {
+            Extend(k + 1, transversal_[k][x]->Inverse() * t);
+            return;
+        }
+        transversal_[k][x] = t;
+        auto generators = generators_[k];
+        for (const auto& generator : generators) {
+            Update(k, generator * t);
+        }
+    }
+
+    template <typename Pred, typename Prune, typename Found>
+    bool Backtrack(size_t k, const Permutation& prefix, Pred& pred, Prune& prune, Found found) const {
+        if (k == n_) {
+            return pred(prefix) && found(prefix);
+        }
+        for (size_t x = 0; x < n_; ++x) {
+            if (!transversal_[k][x]) {
+                continue;
+            }
+            Permutation next = prefix * *transversal_[k][x];
+            if (!prune(k + 1, next)) {
+                continue;
+            }
+            if (Backtrack(k + 1, next, pred, prune, found)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t n_;
+    std::vector<size_t> base_;
+    std::vector<std::vector<Permutation>> generators_;
+    std::vector<std::vector<std::optional<Permutation>>> transversal_;
+};
@@ -1,26 +1,105 @@
 #pragma once
 
+#include "format.h"
 #include "mymath.h"
 #include "myconcepts.h"
+#include "trace.h"
 
+#include <cstddef>
 #include <cstdlib>
 #include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <map>
+#include <memory_resource>
+#include <new>
+#include <string>
 #include <utility>
 #include <vector>
 
+// Scope in which every Poly created on this thread takes its coefficient
+// nodes from an arena instead of the heap. Map nodes of one Poly type all have
+// the same size, so freed blocks go to a free list per size and are handed out
+// again; the whole arena goes back to the heap at once when it dies.
+// Polys created inside must not outlive the arena: move or copy results into
+// a Poly created outside of it, which keeps that Poly's allocator.
+// Arenas nest; the innermost one is used
+class PolyArena : public std::pmr::memory_resource {
+public:
+    PolyArena() : previous_(Current()) {
+        Current() = this;
+    }
+    PolyArena(const PolyArena& other) = delete;
+    PolyArena& operator=(const PolyArena& other) = delete;
+
+    ~PolyArena() override {
+        Current() = previous_;
+    }
+
+    static std::pmr::memory_resource* Resource() {
+        return Current();
+    }
+
+private:
+    static constexpr size_t GRANULARITY = alignof(std::max_align_t);
+    static constexpr size_t SIZE_CLASSES = 16;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static std::pmr::memory_resource*& Current() {
+        thread_local std::pmr::memory_resource* resource = std::pmr::new_delete_resource();
+        return resource;
+    }
+
+    static size_t SizeClass(size_t bytes) {
+        return (bytes + GRANULARITY - 1) / GRANULARITY - 1;
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        size_t size_class = SizeClass(bytes);
+        if (size_class >= SIZE_CLASSES || alignment > GRANULARITY) {
+            return buffer_.allocate(bytes, alignment);
+        }
+        if (FreeBlock* block = free_[size_class]) {
+            free_[size_class] = block->next;
+            return block;
+        }
+        return buffer_.allocate((size_class + 1) * GRANULARITY, GRANULARITY);
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        size_t size_class = SizeClass(bytes);
+        if (size_class >= SIZE_CLASSES || alignment > GRANULARITY) {
+            return;
+        }
+        free_[size_class] = new (pointer) FreeBlock{free_[size_class]};
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::monotonic_buffer_resource buffer_;
+    FreeBlock* free_[SIZE_CLASSES] = {};
+    std::pmr::memory_resource* previous_;
+};
+
 template <RingWithOne T>
 class Poly {
 public:
+    using Coefficients = std::pmr::map<size_t, T, std::greater<size_t>>;
+
     Poly() {}
-    Poly(const Poly& other) = default;
+    // A copy allocates from the current arena, not from the one of other
+    Poly(const Poly& other) : coefficients_(other.coefficients_, PolyArena::Resource()) {}
     Poly(Poly&& other) = default;
     Poly& operator=(const Poly& other) = default;
     Poly& operator=(Poly&& other) = default;
     Poly(const T& coefficient): Poly(coefficient, 0) {}
-    Poly(const T& coefficient, size_t power): coefficients_({{power, coefficient}}) {
+    Poly(const T& coefficient, size_t power) {
+        coefficients_.emplace(power, coefficient);
         Clean();
     }
     Poly(const std::vector<T>& coefficients) {
@@ -30,7 +109,8 @@ public:
             }
         }
     }
-    Poly(const std::map<size_t, T, std::greater<size_t>> coefficients): coefficients_(coefficients) {
+    Poly(const std::map<size_t, T, std::greater<size_t>> coefficients)
+        : coefficients_(coefficients.begin(), coefficients.end(), PolyArena::Resource()) {
         Clean();
     }
     Poly(const std::initializer_list<T>& coefficients): Poly(std::vector<T>(coefficients)) {}
@@ -72,21 +152,43 @@ public:
 
     Poly operator+(const Poly& other) const {
         Poly ans(*this);
-        for (const auto& [power, coefficient] : other.coefficients_) {
-            ans.coefficients_[power] += coefficient;
-        }
-        ans.Clean();
+        ans += other;
         return ans;
     }
     Poly operator-() const {
+        return -Poly(*this);
+    }
+    Poly operator-(const Poly& other) const {
         Poly ans(*this);
-        for (auto &[power, coefficient] : ans.coefficients_) {
-            coefficient = -coefficient;
-        }
+        ans -= other;
         return ans;
     }
-    Poly operator-(const Poly& other) const {
-        return *this + -other;
+
+    friend Poly operator+(Poly&& a, const Poly& b) {
+        a += b;
+        return std::move(a);
+    }
+    friend Poly operator+(const Poly& a, Poly&& b) {
+        b += a;
+        return std::move(b);
+    }
+    friend Poly operator+(Poly&& a, Poly&& b) {
+        a += b;
+        return std::move(a);
+    }
+    friend Poly operator-(Poly&& a, const Poly& b) {
+        a -= b;
+        return std::move(a);
+    }
+    friend Poly operator-(Poly&& a, Poly&& b) {
+        a -= b;
+        return std::move(a);
+    }
+    friend Poly operator-(Poly&& a) {
+        for (auto& [power, coefficient] : a.coefficients_) {
+            coefficient = -coefficient;
+        }
+        return std::move(a);
     }
     Poly operator*(const Poly& other) const {
         Poly ans;
@@ -100,6 +202,7 @@ public:
     }
 
     Poly try_devide(const Poly& other) const {
+        TRACE_SPAN("Poly::try_devide", deg(), other.deg());
         if (*this == Poly::ZERO()) {
             return Poly::ZERO();
         }
@@ -127,9 +230,7 @@ public:
 
     Poly operator/(const T& other) const requires Field<T> {
         Poly ans = *this;
-        for (auto& [power, coeff] : ans.coefficients_) {
-            coeff /= other;
-        }
+        ans /= other;
         return ans;
     }
 
@@ -152,17 +253,42 @@ public:
         return cpthis;
     }
 
+    // Only the touched terms are checked for cancellation
     Poly& operator+=(const Poly& other) {
-        return *this = *this + other;
+        if (this == &other) {
+            return *this = *this + Poly(other);
+        }
+        for (const auto& [power, coefficient] : other.coefficients_) {
+            auto it = coefficients_.try_emplace(power, T::ZERO()).first;
+            it->second += coefficient;
+            if (it->second == T::ZERO()) {
+                coefficients_.erase(it);
+            }
+        }
+        return *this;
     }
     Poly& operator-=(const Poly& other) {
-        return *this = *this - other;
+        if (this == &other) {
+            coefficients_.clear();
+            return *this;
+        }
+        for (const auto& [power, coefficient] : other.coefficients_) {
+            auto it = coefficients_.try_emplace(power, T::ZERO()).first;
+            it->second -= coefficient;
+            if (it->second == T::ZERO()) {
+                coefficients_.erase(it);
+            }
+        }
+        return *this;
     }
     Poly& operator*=(const Poly& other) {
         return *this = *this * other;
     }
     Poly& operator/=(const T& other) requires Field<T> {
-        return *this = *this / other;
+        for (auto& [power, coeff] : coefficients_) {
+            coeff /= other;
+        }
+        return *this;
     }
     Poly& operator/=(const Poly& other) requires Field<T> {
         return *this = *this / other;
@@ -171,11 +297,11 @@ public:
         return *this = *this % other;
     }
 
-    std::map<size_t, T, std::greater<size_t>> GetCoefficients() const {
+    const Coefficients& GetCoefficients() const {
         return coefficients_;
     }
 
-    std::map<size_t, T, std::greater<size_t>>& GetCoefficients() {
+    Coefficients& GetCoefficients() {
         return coefficients_;
     }
 
@@ -199,10 +325,10 @@ public:
         return coefficients_.begin() -> first;
     }
 
-    friend std::ostream& operator<<(std::ostream& stream, const Poly& polynomial) {
+    friend void FormatTo(std::string& buffer, const Poly& polynomial) {
         if (polynomial.coefficients_.empty()) {
-            stream << T::ZERO();
-            return stream;
+            FormatTo(buffer, T::ZERO());
+            return;
         }
         bool first = true;
         for (const auto& [power, coefficient] : polynomial.coefficients_) {
@@ -210,31 +336,30 @@ public:
             if (first) {
                 first = false;
                 if (coefficient != T::ONE() || power == 0) {
-                    stream << coefficient;
+                    FormatTo(buffer, coefficient);
                 }
-                if (power == 0) {
-                    continue;
-                }
-                if (power == 1) {
-                    stream << "x";
-                    continue;
+            } else {
+                buffer += coefficient < T::ZERO() ? " - " : " + ";
+                if (abs(coefficient) != T::ONE() || power == 0) {
+                    FormatTo(buffer, abs(coefficient));
                 }
-                stream << "x^" << power;
-                continue;
-            }
-            stream << ' ' << (coefficient < T::ZERO() ? '-' : '+') << ' ';
-            if (abs(coefficient) != T::ONE() || power == 0) {
-                stream << abs(coefficient);
             }
             if (power == 0) {
                 continue;
             }
-            stream << 'x';
+            buffer += 'x';
             if (power == 1) {
                 continue;
             }
-            stream << '^' << power;
+            buffer += '^';
+            FormatTo(buffer, static_cast<long long>(power));
         }
+    }
+
+    friend std::ostream& operator<<(std::ostream& stream, const Poly& polynomial) {
+        std::string buffer;
+        FormatTo(buffer, polynomial);
+        stream << buffer;
         return stream;
     }
 
@@ -246,6 +371,6 @@ public:
     }
 
 private:
-    std::map<size_t, T, std::greater<size_t>> coefficients_;
+    Coefficients coefficients_{PolyArena::Resource()};
 };
 
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "dense_poly.h"
+#include "mymath.h"
+#include "myconcepts.h"
+#include "poly.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Half-gcd (Knuth–Schönhage) for polynomials over a field.
+// Euclid makes O(n) division steps of cost O(n) each. Half-gcd finds the first
+// half of the quotient sequence using only the top halves of the inputs, so
+// the whole remainder sequence costs O(M(n) log n).
+
+// 2x2 polynomial matrix mapping a pair of consecutive remainders to a later pair:
+// (c, d) = M (a, b)
+template <Field T>
+struct EuclidMatrix {
+    DensePoly<T> m00 = DensePoly<T>::ONE();
+    DensePoly<T> m01;
+    DensePoly<T> m10;
+    DensePoly<T> m11 = DensePoly<T>::ONE();
+
+    EuclidMatrix operator*(const EuclidMatrix& other) const {
+        EuclidMatrix ans;
+        ans.m00 = m00 * other.m00 + m01 * other.m10;
+        ans.m01 = m00 * other.m01 + m01 * other.m11;
+        ans.m10 = m10 * other.m00 + m11 * other.m10;
+        ans.m11 = m10 * other.m01 + m11 * other.m11;
+        return ans;
+    }
+
+    std::pair<DensePoly<T>, DensePoly<T>> Apply(const DensePoly<T>& a, const DensePoly<T>& b) const {
+        return {m00 * a + m01 * b, m10 * a + m11 * b};
+    }
+
+    // Multiplies by (0 1; 1 -q) from the left, i.e. one Euclid step with quotient q
+    void Step(const DensePoly<T>& q) {
+        DensePoly<T> new10 = m00 - q * m10;
+        DensePoly<T> new11 = m01 - q * m11;
+        m00 = std::move(m10);
+        m01 = std::move(m11);
+        m10 = std::move(new10);
+        m11 = std::move(new11);
+    }
+};
+
+// Degree and leading coefficient of every divisor in the remainder sequence,
+// that is all Resultant needs
+template <Field T>
+using EuclidSteps = std::vector<std::pair<ptrdiff_t, T>>;
+
+template <Field T>
+class HalfGcd {
+public:
+    // Runs the remainder sequence of (a, b) until the second element has degree < k.
+    // Returns the transformation and the final pair (c, d) with deg c >= k > deg d
+    static std::tuple<EuclidMatrix<T>, DensePoly<T>, DensePoly<T>> Reduce(DensePoly<T> a, DensePoly<T> b, ptrdiff_t k,
+                                                                          EuclidSteps<T>* steps = nullptr) {
+        EuclidMatrix<T> total;
+        while (b.deg() >= k) {
+            if (a.deg() > b.deg()) {
+                ptrdiff_t shift = std::max<ptrdiff_t>(0, 2 * k - a.deg());
+                auto transform = Recursive(a.ShiftRight(shift), b.ShiftRight(shift), shift, steps);
+                std::tie(a, b) = transform.Apply(a, b);
+                total = transform * total;
+                if (b.deg() < k) {
+                    break;
+                }
+            }
+            auto [q, r] = a.DivMod(b);
+            Record(steps, b, 0);
+            total.Step(q);
+            a = std::move(b);
+            b = std::move(r);
+        }
+        return {std::move(total), std::move(a), std::move(b)};
+    }
+
+private:
+    static const ptrdiff_t THRESHOLD = 64;
+
+    static void Record(EuclidSteps<T>* steps, const DensePoly<T>& divisor, ptrdiff_t shift) {
+        if (steps != nullptr) {
+            steps->emplace_back(divisor.deg() + shift, divisor.SeniorCoefficient());
+        }
+    }
+
+    // deg a > deg b. Returns M with (c, d) = M (a, b) consecutive remainders,
+    // deg c >= ceil(deg a / 2) > deg d. shift is how far a and b were truncated
+    // from the real polynomials, it's needed only to record real degrees
+    static EuclidMatrix<T> Recursive(DensePoly<T> a, DensePoly<T> b, ptrdiff_t shift, EuclidSteps<T>* steps) {
+        ptrdiff_t n = a.deg();
+        ptrdiff_t m = (n + 1) / 2;
+        EuclidMatrix<T> ans;
+        if (b.deg() < m) {
+            return ans;
+        }
+        if (n < THRESHOLD) {
+            while (b.deg() >= m) {
+                auto [q, r] = a.DivMod(b);
+                Record(steps, b, shift);
+                ans.Step(q);
+                a = std::move(b);
+                b = std::move(r);
+            }
+            return ans;
+        }
+        ans = Recursive(a.ShiftRight(m), b.ShiftRight(m), shift + m, steps);
+        auto [c, d] = ans.Apply(a, b);
+        if (d.deg() < m) {
+            return ans;
+        }
+        auto [q, r] = c.DivMod(d);
+        Record(steps, d, shift);
+        ans.Step(q);
+        if (r.deg() < m) {
+            return ans;
+        }
+        ptrdiff_t k = 2 * m - d.deg();
+        return Recursive(d.ShiftRight(k), r.ShiftRight(k), shift + k, steps) * ans;
+    }
+};
+
+// Returns (g, s, t) with g = s * a + t * b, g monic (or zero if a = b = 0)
+template <Field T>
+std::tuple<Poly<T>, Poly<T>, Poly<T>> ExtendedGcd(const Poly<T>& a, const Poly<T>& b) {
+    auto [transform, g, zero] = HalfGcd<T>::Reduce(DensePoly<T>(a), DensePoly<T>(b), 0);
+    if (g == DensePoly<T>::ZERO()) {
+        return {Poly<T>::ZERO(), Poly<T>::ONE(), Poly<T>::ZERO()};
+    }
+    T senior = g.SeniorCoefficient();
+    return {(g / senior).ToPoly(), (transform.m00 / senior).ToPoly(), (transform.m01 / senior).ToPoly()};
+}
+
+// Picked over the Euclid from mymath.h, so Fraction<Poly<T>>::Shorten uses it too
+template <Field T>
+Poly<T> gcd(const Poly<T>& a, const Poly<T>& b) {
+    return std::get<0>(ExtendedGcd(a, b));
+}
+
+template <Field T>
+T Resultant(const Poly<T>& a, const Poly<T>& b) {
+    if (a == Poly<T>::ZERO() || b == Poly<T>::ZERO()) {
+        return T::ZERO();
+    }
+    DensePoly<T> da(a);
+    EuclidSteps<T> steps;
+    auto [transform, g, zero] = HalfGcd<T>::Reduce(da, DensePoly<T>(b), 0, &steps);
+    if (g.deg() > 0) {
+        return T::ZERO();
+    }
+    // res(a, b) = (-1)^(deg a * deg b) * lc(b)^(deg a - deg r) * res(b, r), where r = a mod b
+    T ans = T::ONE();
+    ptrdiff_t dividend = da.deg();
+    for (size_t i = 0; i < steps.size(); ++i) {
+        auto [divisor, senior] = steps[i];
+        ptrdiff_t rest = (i + 1 < steps.size() ? steps[i + 1].first : 0);
+        ans *= fastpow(senior, static_cast<size_t>(dividend - rest));
+        if (dividend % 2 == 1 && divisor % 2 == 1) {
+            ans = -ans;
+        }
+        dividend = divisor;
+    }
+    return ans;
+}
+
+// Finds r / t with r = t * u (mod m), deg r < k and deg t <= deg m - k.
+// Returns nothing if there is no such fraction with t coprime to m
+template <Field T>
+std::optional<std::pair<Poly<T>, Poly<T>>> RationalReconstruction(const Poly<T>& u, const Poly<T>& m, size_t k) {
+    DensePoly<T> dm(m);
+    auto [transform, c, r] = HalfGcd<T>::Reduce(dm, DensePoly<T>(u) % dm, static_cast<ptrdiff_t>(k));
+    DensePoly<T> t = transform.m11;
+    if (t == DensePoly<T>::ZERO() || gcd(t.ToPoly(), m) != Poly<T>::ONE()) {
+        return std::nullopt;
+    }
+    T senior = t.SeniorCoefficient();
+    return std::make_pair((r / senior).ToPoly(), (t / senior).ToPoly());
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "exceptions.h"
+#include "matrix.h"
+#include "myconcepts.h"
+#include "poly.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Polynomial with n x m matrix coefficients, A(x) = A_0 + A_1 x + ... + A_d x^d,
+// stored from x^0 up. The same thing as a Matrix<Poly<T>>, but a power of x
+// for all entries is one dense matrix instead of a map per entry, so that
+// evaluation is d matrix axpys and products are products of matrices
+template <RingWithOne T>
+class PolyMatrix {
+public:
+    PolyMatrix(size_t n, size_t m) : n_(n), m_(m) {}
+    PolyMatrix(const PolyMatrix& other) = default;
+    PolyMatrix(PolyMatrix&& other) = default;
+    PolyMatrix& operator=(const PolyMatrix& other) = default;
+    PolyMatrix& operator=(PolyMatrix&& other) = default;
+
+    PolyMatrix(const Matrix<T>& coefficient) : PolyMatrix(std::vector<Matrix<T>>{coefficient}) {}
+    // Coefficients from x^0 up, all of the same size
+    PolyMatrix(std::vector<Matrix<T>> coefficients) : n_(0), m_(0), data_(std::move(coefficients)) {
+        if (data_.empty()) {
+            return;
+        }
+        n_ = data_[0].nsize();
+        m_ = data_[0].msize();
+        for (const auto& coefficient : data_) {
+            if (coefficient.size() != size()) {
+                throw WrongSizeException();
+            }
+        }
+        Clean();
+    }
+
+    explicit PolyMatrix(const Matrix<Poly<T>>& matrix) : n_(matrix.nsize()), m_(matrix.msize()) {
+        size_t degree = 0;
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t j = 0; j < m_; ++j) {
+                degree = std::max(degree, matrix[i][j].deg());
+            }
+        }
+        data_.assign(degree + 1, Matrix<T>(n_, m_));
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t j = 0; j < m_; ++j) {
+                for (const auto& [power, coefficient] : matrix[i][j].GetCoefficients()) {
+                    data_[power][i][j] = coefficient;
+                }
+            }
+        }
+        Clean();
+    }
+
+    Matrix<Poly<T>> ToMatrix() const {
+        Matrix<Poly<T>> ans(n_, m_);
+        std::vector<T> entry(data_.size(), T::ZERO());
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t j = 0; j < m_; ++j) {
+                for (size_t power = 0; power < data_.size(); ++power) {
+                    entry[power] = data_[power][i][j];
+                }
+                ans[i][j] = Poly<T>(entry);
+            }
+        }
+        return ans;
+    }
+
+    bool operator==(const PolyMatrix& other) const = default;
+    bool operator!=(const PolyMatrix& other) const = default;
+
+    size_t nsize() const {
+        return n_;
+    }
+    size_t msize() const {
+        return m_;
+    }
+    std::pair<size_t, size_t> size() const {
+        return std::make_pair(n_, m_);
+    }
+
+    // Like DensePoly::deg, -1 for zero
+    ptrdiff_t deg() const {
+        return static_cast<ptrdiff_t>(data_.size()) - 1;
+    }
+
+    const std::vector<Matrix<T>>& GetCoefficients() const {
+        return data_;
+    }
+
+    // Horner: ans = ans * x + A_k from the top coefficient down
+    Matrix<T> operator()(const T& x) const {
+        Matrix<T> ans(n_, m_);
+        for (size_t k = data_.size(); k-- > 0;) {
+            const Matrix<T>& coefficient = data_[k];
+            for (size_t i = 0; i < n_; ++i) {
+                for (size_t j = 0; j < m_; ++j) {
+                    ans[i][j] *= x;
+                    ans[i][j] += coefficient[i][j];
+                }
+            }
+        }
+        return ans;
+    }
+
+    PolyMatrix& operator+=(const PolyMatrix& other) {
+        if (other.size() != size()) {
+            throw WrongSizeException();
+        }
+        if (data_.size() < other.data_.size()) {
+            data_.resize(other.data_.size(), Matrix<T>(n_, m_));
+        }
+        for (size_t k = 0; k < other.data_.size(); ++k) {
+            data_[k] += other.data_[k];
+        }
+        Clean();
+        return *this;
+    }
+    PolyMatrix& operator-=(const PolyMatrix& other) {
+        if (other.size() != size()) {
+            throw WrongSizeException();
+        }
+        if (data_.size() < other.data_.size()) {
+            data_.resize(other.data_.size(), Matrix<T>(n_, m_));
+        }
+        for (size_t k = 0; k < other.data_.size(); ++k) {
+            data_[k] -= other.data_[k];
+        }
+        Clean();
+        return *this;
+    }
+    PolyMatrix operator+(const PolyMatrix& other) const {
+        PolyMatrix ans = *this;
+        ans += other;
+        return ans;
+    }
+    PolyMatrix operator-(const PolyMatrix& other) const {
+        PolyMatrix ans = *this;
+        ans -= other;
+        return ans;
+    }
+    PolyMatrix operator-() const {
+        PolyMatrix ans = *this;
+        for (auto& coefficient : ans.data_) {
+            coefficient = -std::move(coefficient);
+        }
+        return ans;
+    }
+
+    PolyMatrix operator*(const PolyMatrix& other) const {
+        if (m_ != other.n_) {
+            throw WrongSizeException();
+        }
+        PolyMatrix ans(n_, other.m_);
+        if (data_.empty() || other.data_.empty()) {
+            return ans;
+        }
+        ans.data_.assign(data_.size() + other.data_.size() - 1, Matrix<T>(n_, other.m_));
+        Multiply(data_.data(), data_.size(), other.data_.data(), other.data_.size(), ans.data_.data());
+        ans.Clean();
+        return ans;
+    }
+    PolyMatrix& operator*=(const PolyMatrix& other) {
+        return *this = *this * other;
+    }
+
+    PolyMatrix operator*(const T& lambda) const {
+        PolyMatrix ans = *this;
+        for (auto& coefficient : ans.data_) {
+            coefficient *= lambda;
+        }
+        ans.Clean();
+        return ans;
+    }
+
+private:
+    // The products below are n x m times m x k, which is where all the time
+    // goes, so Karatsuba pays off much earlier than for scalars
+    static const size_t KARATSUBA_THRESHOLD = 4;
+
+    // out[0, n + m - 1) += a[0, n) * b[0, m), coefficient matrices in the order
+    // given since they don't commute. Same cutting as DensePoly::Multiply
+    static void Multiply(const Matrix<T>* a, size_t n, const Matrix<T>* b, size_t m, Matrix<T>* out) {
+        if (n <= KARATSUBA_THRESHOLD || m <= KARATSUBA_THRESHOLD) {
+            Schoolbook(a, n, b, m, out);
+            return;
+        }
+        auto rows = a[0].nsize();
+        auto cols = b[0].msize();
+        size_t len = std::min(n, m);
+        // Cut the longer operand into pieces of the shorter one's length
+        bool cut_a = n >= m;
+        const Matrix<T>* whole = cut_a ? b : a;
+        const Matrix<T>* cut = cut_a ? a : b;
+        size_t cut_size = cut_a ? n : m;
+        std::vector<Matrix<T>> piece(len, cut_a ? Matrix<T>(rows, a[0].msize()) : Matrix<T>(b[0].nsize(), cols));
+        std::vector<Matrix<T>> product(2 * len, Matrix<T>(rows, cols));
+        for (size_t start = 0; start < cut_size; start += len) {
+            size_t piece_len = std::min(len, cut_size - start);
+            for (size_t i = 0; i < len; ++i) {
+                piece[i] = i < piece_len ? cut[start + i] : Matrix<T>(piece[i].size());
+            }
+            for (auto& coefficient : product) {
+                coefficient = Matrix<T>(rows, cols);
+            }
+            if (cut_a) {
+                Karatsuba(piece.data(), whole, len, product.data());
+            } else {
+                Karatsuba(whole, piece.data(), len, product.data());
+            }
+            for (size_t i = 0; i + 1 < piece_len + len; ++i) {
+                out[start + i] += product[i];
+            }
+        }
+    }
+
+    static void Schoolbook(const Matrix<T>* a, size_t n, const Matrix<T>* b, size_t m, Matrix<T>* out) {
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < m; ++j) {
+                out[i + j] += a[i] * b[j];
+            }
+        }
+    }
+
+    // out[0, 2n) += a[0, n) * b[0, n)
+    static void Karatsuba(const Matrix<T>* a, const Matrix<T>* b, size_t n, Matrix<T>* out) {
+        if (n <= KARATSUBA_THRESHOLD) {
+            Schoolbook(a, n, b, n, out);
+            return;
+        }
+        auto rows = a[0].nsize();
+        auto cols = b[0].msize();
+        size_t low = n / 2;
+        size_t high = n - low;
+        std::vector<Matrix<T>> z0(2 * low, Matrix<T>(rows, cols));
+        std::vector<Matrix<T>> z1(2 * high, Matrix<T>(rows, cols));
+        std::vector<Matrix<T>> z2(2 * high, Matrix<T>(rows, cols));
+        Karatsuba(a, b, low, z0.data());
+        Karatsuba(a + low, b + low, high, z2.data());
+        std::vector<Matrix<T>> sum_a(a + low, a + n);
+        std::vector<Matrix<T>> sum_b(b + low, b + n);
+        for (size_t i = 0; i < low; ++i) {
+            sum_a[i] += a[i];
+            sum_b[i] += b[i];
+        }
+        Karatsuba(sum_a.data(), sum_b.data(), high, z1.data());
+        for (size_t i = 0; i < 2 * low; ++i) {
+            z1[i] -= z0[i];
+            out[i] += z0[i];
+        }
+        for (size_t i = 0; i < 2 * high; ++i) {
+            z1[i] -= z2[i];
+            out[i + 2 * low] += z2[i];
+        }
+        for (size_t i = 0; i < 2 * high; ++i) {
+            out[i + low] += z1[i];
+        }
+    }
+
+    void Clean() {
+        Matrix<T> zero(n_, m_);
+        while (!data_.empty() && data_.back() == zero) {
+            data_.pop_back();
+        }
+    }
+
+    size_t n_;
+    size_t m_;
+    std::vector<Matrix<T>> data_;
+};
+
+template <RingWithOne T>
+PolyMatrix<T> operator*(const T& lambda, const PolyMatrix<T>& matrix) {
+    return matrix * lambda;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "exceptions.h"
+#include "matrix.h"
+#include "myconcepts.h"
+#include "thread_pool.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Compressed sparse rows: memory is O(n + nnz), and a product with a block of
+// vectors goes through the nonzeros once, split by rows between threads
+template <RingWithOne T>
+class SparseMatrix {
+public:
+    using Entry = std::tuple<size_t, size_t, T>;
+
+    SparseMatrix(size_t n, size_t m) : n_(n), m_(m), row_starts_(n + 1, 0) {}
+
+    // Entries may come in any order, repeated positions are summed up
+    SparseMatrix(size_t n, size_t m, std::vector<Entry> entries) : n_(n), m_(m), row_starts_(n + 1, 0) {
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return std::tie(std::get<0>(a), std::get<1>(a)) < std::tie(std::get<0>(b), std::get<1>(b));
+        });
+        for (size_t k = 0; k < entries.size();) {
+            auto [i, j, value] = entries[k];
+            if (i >= n || j >= m) {
+                throw WrongSizeException();
+            }
+            for (++k; k < entries.size() && std::get<0>(entries[k]) == i && std::get<1>(entries[k]) == j; ++k) {
+                value += std::get<2>(entries[k]);
+            }
+            if (value != T::ZERO()) {
+                columns_.push_back(j);
+                values_.push_back(value);
+                ++row_starts_[i + 1];
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            row_starts_[i + 1] += row_starts_[i];
+        }
+    }
+
+    SparseMatrix(const Matrix<T>& matrix) : n_(matrix.nsize()), m_(matrix.msize()), row_starts_(n_ + 1, 0) {
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t j = 0; j < m_; ++j) {
+                if (matrix[i][j] != T::ZERO()) {
+                    columns_.push_back(j);
+                    values_.push_back(matrix[i][j]);
+                }
+            }
+            row_starts_[i + 1] = columns_.size();
+        }
+    }
+
+    size_t nsize() const {
+        return n_;
+    }
+    size_t msize() const {
+        return m_;
+    }
+    size_t nnz() const {
+        return values_.size();
+    }
+
+    Vector<T> operator*(const Vector<T>& v) const {
+        if (v.size() != m_) {
+            throw WrongSizeException();
+        }
+        Vector<T> ans(n_);
+        for (size_t i = 0; i < n_; ++i) {
+            ans[i] = RowProduct(i, v);
+        }
+        return ans;
+    }
+
+    std::vector<Vector<T>> operator*(const std::vector<Vector<T>>& block) const {
+        std::vector<Vector<T>> ans(block.size(), Vector<T>(n_));
+        for (const auto& v : block) {
+            if (v.size() != m_) {
+                throw WrongSizeException();
+            }
+        }
+        size_t chunks = (n_ + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        ThreadPool::Global().ParallelFor(chunks, [&](size_t chunk) {
+            size_t begin = chunk * ROWS_PER_TASK;
+            for (size_t i = begin; i < std::min(n_, begin + ROWS_PER_TASK); ++i) {
+                for (size_t b = 0; b < block.size(); ++b) {
+                    ans[b][i] = RowProduct(i, block[b]);
+                }
+            }
+        });
+        return ans;
+    }
+
+    SparseMatrix Transpose() const {
+        SparseMatrix ans(m_, n_);
+        ans.columns_.resize(nnz());
+        ans.values_.assign(nnz(), T::ZERO());
+        for (size_t j : columns_) {
+            ++ans.row_starts_[j + 1];
+        }
+        for (size_t j = 0; j < m_; ++j) {
+            ans.row_starts_[j + 1] += ans.row_starts_[j];
+        }
+        std::vector<size_t> position(ans.row_starts_.begin(), ans.row_starts_.end() - 1);
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t k = row_starts_[i]; k < row_starts_[i + 1]; ++k) {
+                size_t& to = position[columns_[k]];
+                ans.columns_[to] = i;
+                ans.values_[to] = values_[k];
+                ++to;
+            }
+        }
+        return ans;
+    }
+
+    Matrix<T> ToMatrix() const {
+        Matrix<T> ans(n_, m_);
+        for (size_t i = 0; i < n_; ++i) {
+            for (size_t k = row_starts_[i]; k < row_starts_[i + 1]; ++k) {
+                ans[i][columns_[k]] = values_[k];
+            }
+        }
+        return ans;
+    }
+
+private:
+    static constexpr size_t ROWS_PER_TASK = 256;
+
+    T RowProduct(size_t i, const Vector<T>& v) const {
+        T sum = T::ZERO();
+        for (size_t k = row_starts_[i]; k < row_starts_[i + 1]; ++k) {
+            sum += values_[k] * v[columns_[k]];
+        }
+        return sum;
+    }
+
+    size_t n_;
+    size_t m_;
+    std::vector<size_t> row_starts_;
+    std::vector<size_t> columns_;
+    std::vector<T> values_;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "execution_control.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency())) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { Work(); });
+        }
+    }
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stopped_ = true;
+        }
+        wakeup_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers_.size();
+    }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Submit(F task) {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(task));
+        auto result = packaged->get_future();
+        Push([packaged] { (*packaged)(); });
+        return result;
+    }
+
+    // Calls body(i) for every i in [0, count) and waits for all of them.
+    // The calling thread takes indices too, so it's fine to call this from
+    // inside a task of the same pool: if every worker is busy the caller just
+    // does all the work itself. The caller's ExecutionControl is current in
+    // every thread that runs body
+    template <typename F>
+    void ParallelFor(size_t count, F body) {
+        struct State {
+            std::atomic<size_t> next = 0;
+            std::atomic<size_t> done = 0;
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<State>();
+        auto run = [state, count, body, control = ExecutionControl::Current()]() {
+            ExecutionScope scope(control);
+            size_t i;
+            while ((i = state->next++) < count) {
+                try {
+                    body(i);
+                } catch (...) {
+                    std::lock_guard lock(state->mutex);
+                    if (!state->error) {
+                        state->error = std::current_exception();
+                    }
+                }
+                if (++state->done == count) {
+                    std::lock_guard lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+        size_t helpers = std::min(count, size());
+        for (size_t i = 1; i < helpers; ++i) {
+            Push(run);
+        }
+        run();
+        std::unique_lock lock(state->mutex);
+        state->finished.wait(lock, [&] { return state->done == count; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    static ThreadPool& Global() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+    void Push(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.push(std::move(task));
+        }
+        wakeup_.notify_one();
+    }
+
+    void Work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                wakeup_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stopped_ = false;
+};
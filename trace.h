@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Spans around the hot paths, compiled in only with -DMATRIX_TRACING: without
+// it TRACE_SPAN expands to nothing and its arguments aren't even evaluated.
+// Finished spans go to a ring buffer that keeps the latest CAPACITY of them
+// and can be dumped as a Chrome trace_event file (chrome://tracing, Perfetto)
+struct TraceEvent {
+    const char* name;
+    size_t rows;
+    size_t cols;
+    size_t thread;
+    uint64_t start_us;
+    uint64_t duration_us;
+};
+
+class TraceBuffer {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+    explicit TraceBuffer(size_t capacity = DEFAULT_CAPACITY) : events_(capacity) {}
+
+    static TraceBuffer& Global() {
+        static TraceBuffer buffer;
+        return buffer;
+    }
+
+    void Record(const TraceEvent& event) {
+        std::lock_guard lock(mutex_);
+        events_[recorded_ % events_.size()] = event;
+        ++recorded_;
+    }
+
+    // Oldest first
+    std::vector<TraceEvent> Snapshot() const {
+        std::lock_guard lock(mutex_);
+        std::vector<TraceEvent> ans;
+        size_t count = std::min(recorded_, events_.size());
+        for (size_t i = recorded_ - count; i < recorded_; ++i) {
+            ans.push_back(events_[i % events_.size()]);
+        }
+        return ans;
+    }
+
+    // Spans overwritten since the last Clear
+    size_t Dropped() const {
+        std::lock_guard lock(mutex_);
+        return recorded_ - std::min(recorded_, events_.size());
+    }
+
+    void Clear() {
+        std::lock_guard lock(mutex_);
+        recorded_ = 0;
+    }
+
+    void WriteChromeTrace(std::ostream& out) const {
+        out << "{\"traceEvents\": [";
+        bool first = true;
+        for (const auto& event : Snapshot()) {
+            out << (first ? "" : ",") << "\n  {\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                << event.thread << ", \"ts\": " << event.start_us << ", \"dur\": " << event.duration_us
+                << ", \"args\": {\"rows\": " << event.rows << ", \"cols\": " << event.cols << "}}";
+            first = false;
+        }
+        out << "\n]}\n";
+    }
+
+    bool WriteChromeTrace(const std::string& path) const {
+        std::ofstream out(path);
+        WriteChromeTrace(out);
+        return static_cast<bool>(out);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<TraceEvent> events_;
+    size_t recorded_ = 0;
+};
+
+class TraceSpan {
+public:
+    TraceSpan(const char* name, size_t rows = 0, size_t cols = 0)
+        : name_(name), rows_(rows), cols_(cols), start_us_(Now()) {}
+    TraceSpan(const TraceSpan& other) = delete;
+    TraceSpan& operator=(const TraceSpan& other) = delete;
+
+    ~TraceSpan() {
+        TraceBuffer::Global().Record({name_, rows_, cols_, ThreadNumber(), start_us_, Now() - start_us_});
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Since the first span of the process
+    static uint64_t Now() {
+        static const Clock::time_point origin = Clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - origin).count();
+    }
+
+    // Small sequential ids read better in the viewer than hashes of std::thread::id
+    static size_t ThreadNumber() {
+        static std::atomic<size_t> next = 0;
+        thread_local size_t number = next++;
+        return number;
+    }
+
+    const char* name_;
+    size_t rows_;
+    size_t cols_;
+    uint64_t start_us_;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef MATRIX_TRACING
+#define TRACE_SPAN(...) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+#else
+#define TRACE_SPAN(...) static_cast<void>(0)
+#endif
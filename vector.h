@@ -1,11 +1,14 @@
 #pragma once
 
 #include "exceptions.h"
+#include "format.h"
 #include "matrix.h"
 #include "myconcepts.h"
 
 #include <cstddef>
 #include <initializer_list>
+#include <string>
+#include <utility>
 #include <vector>
 
 template<RingWithOne T>
@@ -44,6 +47,9 @@ public:
         }
     }
 
+    bool operator==(const Vector& other) const = default;
+    bool operator!=(const Vector& other) const = default;
+
     size_t size() const {
         return data_.size();
     }
@@ -56,23 +62,13 @@ public:
     }
 
     Vector operator+(const Vector& other) const {
-        if (size() != other.size()) {
-            throw WrongSizeException();
-        }
-        Vector ans;
-        for (size_t i = 0; i < size(); ++i) {
-            ans[i] = other[i] + data_[i];
-        }
+        Vector ans = *this;
+        ans += other;
         return ans;
     }
     Vector operator-(const Vector& other) const {
-        if (size() != other.size()) {
-            throw WrongSizeException();
-        }
-        Vector ans(size());
-        for (size_t i = 0; i < size(); ++i) {
-            ans[i] = data_[i] - other[i];
-        }
+        Vector ans = *this;
+        ans -= other;
         return ans;
     }
     T operator*(const Vector& other) const {
@@ -87,27 +83,76 @@ public:
     }
     Vector operator*(const T& lambda) const {
         Vector ans = *this;
-        for (size_t i = 0; i < size(); ++i) {
-            ans[i] *= lambda;
-        }
+        ans *= lambda;
         return ans;
     }
     Vector operator-() const {
-        Vector ans(size());
-        for (size_t i = 0; i < size(); ++i) {
-            ans[i] = -data_[i];
-        }
-        return ans;
+        return -Vector(*this);
     }
 
     Vector& operator+=(const Vector& other) {
-        return *this = *this + other;
+        if (size() != other.size()) {
+            throw WrongSizeException();
+        }
+        for (size_t i = 0; i < size(); ++i) {
+            data_[i] += other[i];
+        }
+        return *this;
     }
     Vector& operator-=(const Vector& other) {
-        return *this = *this - other;
+        if (size() != other.size()) {
+            throw WrongSizeException();
+        }
+        for (size_t i = 0; i < size(); ++i) {
+            data_[i] -= other[i];
+        }
+        return *this;
     }
     Vector& operator*=(const T& lambda) {
-        return *this = *this * lambda;
+        for (size_t i = 0; i < size(); ++i) {
+            data_[i] *= lambda;
+        }
+        return *this;
+    }
+
+    friend Vector operator+(Vector&& a, const Vector& b) {
+        a += b;
+        return std::move(a);
+    }
+    friend Vector operator+(const Vector& a, Vector&& b) {
+        b += a;
+        return std::move(b);
+    }
+    friend Vector operator+(Vector&& a, Vector&& b) {
+        a += b;
+        return std::move(a);
+    }
+    friend Vector operator-(Vector&& a, const Vector& b) {
+        a -= b;
+        return std::move(a);
+    }
+    friend Vector operator-(const Vector& a, Vector&& b) {
+        if (a.size() != b.size()) {
+            throw WrongSizeException();
+        }
+        for (size_t i = 0; i < b.size(); ++i) {
+            b[i] = a[i] - b[i];
+        }
+        return std::move(b);
+    }
+    friend Vector operator-(Vector&& a, Vector&& b) {
+        a -= b;
+        return std::move(a);
+    }
+    friend Vector operator-(Vector&& a) {
+        for (auto& elem : a.data_) {
+            elem = -elem;
+        }
+        return std::move(a);
+    }
+    friend Vector operator*(Vector&& a, const T& lambda) {
+        a *= lambda;
+        return std::move(a);
     }
 
     operator Matrix<T>() {
@@ -121,13 +166,25 @@ public:
     friend Vector operator*(const T& lambda, const Vector& vec) {
         return vec * lambda;
     }
+    friend Vector operator*(const T& lambda, Vector&& vec) {
+        return std::move(vec) * lambda;
+    }
 
-    friend std::ostream &operator<<(std::ostream& out, const Vector& vec) {
-        out << "(";
+    friend void FormatTo(std::string& buffer, const Vector& vec) {
+        buffer += '(';
         for (size_t i = 0; i < vec.size(); ++i) {
-            out << (i ? ", " : "") << vec[i];
+            if (i) {
+                buffer += ", ";
+            }
+            FormatTo(buffer, vec[i]);
         }
-        out << ")";
+        buffer += ')';
+    }
+
+    friend std::ostream &operator<<(std::ostream& out, const Vector& vec) {
+        std::string buffer;
+        FormatTo(buffer, vec);
+        out << buffer;
         return out;
     }
 
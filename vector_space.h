@@ -3,16 +3,19 @@
 #include "exceptions.h"
 #include "matrix.h"
 #include "myconcepts.h"
+#include "trace.h"
 #include "vector.h"
 
 #include <algorithm>
 #include <cstddef>
+#include <utility>
 #include <vector>
 
 template<typename T>
 class VectorSpace {
 public:
     VectorSpace(const std::vector<Vector<T>>& vectors) { // Linear span
+        TRACE_SPAN("VectorSpace::Span", vectors.size(), vectors.empty() ? 0 : vectors[0].size());
         size_t m = vectors.size();
         size_t n = vectors[0].size();
         Matrix<T> a(n, m);
@@ -35,6 +38,7 @@ public:
     }
 
     VectorSpace(Matrix<T> a) { // FSS
+        TRACE_SPAN("VectorSpace::Kernel", a.nsize(), a.msize());
         size_t m = a.nsize();
         size_t n = a.msize();
         a.Gauss();
@@ -149,26 +153,61 @@ public:
         return VectorSpace(sum_vectors);
     }
 
-    VectorSpace inter(const VectorSpace& other) {
+    // Zassenhaus: one elimination of the block matrix (U U; W 0) gives both spaces.
+    // Rows with a pivot in the left half span U + W, the right halves of the
+    // other nonzero rows span U ∩ W
+    std::pair<VectorSpace, VectorSpace> SumAndIntersection(const VectorSpace& other) const {
         if (vector_size() != other.vector_size()) {
             throw WrongSizeException();
         }
-        Matrix<T> a = GetEquasion();
-        Matrix<T> b = other.GetEquasion();
-        Matrix<T> c(a.nsize() + b.nsize(), a.msize());
-        for (size_t i = 0; i < a.nsize(); ++i) {
-            for (size_t j = 0; j < a.msize(); ++j) {
-                c[i][j] = a[i][j];
+        size_t n = vector_size();
+        size_t n1 = dim();
+        size_t n2 = other.dim();
+        Matrix<T> a(n1 + n2, 2 * n);
+        for (size_t i = 0; i < n1; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                a[i][j] = basis[i][j];
+                a[i][j + n] = basis[i][j];
             }
         }
-        for (size_t i = 0; i < b.nsize(); ++i) {
-            for (size_t j = 0; j < b.msize(); ++j) {
-                c[i + a.nsize()][j] = b[i][j];
+        for (size_t i = 0; i < n2; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                a[i + n1][j] = other.basis[i][j];
             }
         }
-        return VectorSpace(c);
+        a.Gauss();
+        std::vector<Vector<T>> sum;
+        std::vector<Vector<T>> intersection;
+        size_t j = 0;
+        for (size_t i = 0; i < n1 + n2; ++i) {
+            while (j < 2 * n && a[i][j] == T::ZERO()) {
+                ++j;
+            }
+            if (j == 2 * n) {
+                break;
+            }
+            Vector<T> vec(n);
+            for (size_t k = 0; k < n; ++k) {
+                vec[k] = a[i][k + (j < n ? 0 : n)];
+            }
+            (j < n ? sum : intersection).push_back(vec);
+        }
+        return {FromBasis(sum), FromBasis(intersection)};
+    }
+
+    VectorSpace inter(const VectorSpace& other) {
+        return SumAndIntersection(other).second;
+    }
+
+    // Trusts that vectors are linearly independent
+    static VectorSpace FromBasis(std::vector<Vector<T>> vectors) {
+        VectorSpace ans;
+        ans.basis = std::move(vectors);
+        return ans;
     }
 
 private:
+    VectorSpace() {}
+
     std::vector<Vector<T>> basis;
 };